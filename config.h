@@ -29,12 +29,94 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TERM_HOMEROW 200
 #define TAPPING_TERM_HOMEROW_GUI 400
 
-// Caps word.
+// The range that the tapping terms can be set to at runtime, in milliseconds.
 
-#define DOUBLE_TAP_SHIFT_TURNS_ON_CAPS_WORD
-#define CAPS_WORD_IDLE_TIMEOUT 3000
+#define TAPPING_TERM_MIN 50
+#define TAPPING_TERM_MAX 1000
+
+// Caps word. The idle timeout is handled in userspace so that it can be changed
+// at runtime, so the QMK idle timeout is disabled. Double tapping the shift keys
+// is also handled in userspace, so that further taps can pick a caps word mode.
+
+#define CAPS_WORD_IDLE_TIMEOUT 0
+#define CAPS_WORD_IDLE_TIMEOUT_USER 3000
+#define CAPS_WORD_IDLE_TIMEOUT_MAX 60000
+
+// Macro recording. The macro holds up to MACRO_SIZE key events and is played
+// back with the given interval in milliseconds between events for each
+// operating system. Define MACRO_PERSIST to keep the macro in EEPROM, which
+// takes a byte for each event.
+
+#define MACRO_SIZE 128
+#define MACRO_PLAY_INTERVAL_WINDOWS 2
+#define MACRO_PLAY_INTERVAL_CHROMEOS 10
+#define MACRO_PLAY_INTERVAL_LINUX 2
+
+// Runtime settings stored in EEPROM. The settings take up the first
+// HBM_SETTINGS_SIZE bytes, followed by the macro if it is persisted.
+
+#define HBM_SETTINGS_SIZE 16
+
+#ifdef MACRO_PERSIST
+#define EECONFIG_USER_DATA_SIZE (HBM_SETTINGS_SIZE + 1 + MACRO_SIZE)
+#else
+#define EECONFIG_USER_DATA_SIZE HBM_SETTINGS_SIZE
+#endif
+
+// Window switcher. M_ALT_TAB lets go of alt once it has not been pressed for
+// the idle timeout. Holding M_ALT_TAB repeats tab after the repeat delay, with
+// the interval between repeats shrinking by the acceleration each time down to
+// the minimum interval.
+
+#define ALT_TAB_IDLE_TIMEOUT 1000
+#define ALT_TAB_REPEAT_DELAY 400
+#define ALT_TAB_REPEAT_INTERVAL 200
+#define ALT_TAB_REPEAT_MIN_INTERVAL 40
+#define ALT_TAB_REPEAT_ACCEL 20
+
+// Navigation key repeat. Held arrow, home, end and page keys start repeating
+// after the delay, with the interval between steps shrinking by the
+// acceleration after each repeat down to the minimum interval. Each step
+// either presses or releases the key.
+
+#define NAV_REPEAT_DELAY 200
+#define NAV_REPEAT_INTERVAL 25
+#define NAV_REPEAT_MIN_INTERVAL 8
+#define NAV_REPEAT_ACCEL 1
+
+// Mouse keys. The pointer and wheel keys send a report every interval in
+// milliseconds while they are held.
+
+#define MOUSE_INTERVAL 4
+
+// Combos. Keys that are part of a combo are held back for up to this long in
+// milliseconds to see if the rest of the combo is pressed.
+
+#define COMBO_TERM 30
+
+// Leader key. Sequences that are a prefix of a longer sequence are sent once no
+// further key has been pressed for this long.
+
+#define LEADER_TIMEOUT 1000
 
 // Layout macros that allow preprocessor substitutions. Use these instead of the
 // standard LAYOUT_ macros in keymap.c code.
 
 #define HBM_LAYOUT_ferris_sweep(...) LAYOUT_split_3x5_2(__VA_ARGS__)
+
+// Debounce times in milliseconds for each key, laid out in the same order as
+// the keymaps. Presses are reported as soon as they are seen and releases are
+// only reported once the key has been stable for this long. Times must be less
+// than 128.
+
+#define DEBOUNCE 5
+#define DEBOUNCE_THUMB 8
+
+#define LAYOUT_DEBOUNCE \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, DEBOUNCE, \
+  DEBOUNCE_THUMB, DEBOUNCE_THUMB, DEBOUNCE_THUMB, DEBOUNCE_THUMB
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Companion daemon that carries out window actions sent by the keyboard over
+# raw HID on Linux, replacing the four-modifier chords used by shortcuts.ahk
+# on Windows. Needs wmctrl and xdotool.
+#
+# Usage:
+#
+#   hbm_actions.py [--device PATH | --socket PATH] [--dry-run]
+#
+# With --socket the daemon reads reports from a Unix datagram socket instead of
+# the keyboard, so it can be driven without a keyboard attached. With --dry-run
+# the commands are printed instead of run.
+
+import argparse
+import os
+import shlex
+import socket
+import subprocess
+import sys
+
+from hbm_tune import HID_ACTION, REPORT_SIZE, find_device
+
+# These must match hbm_actions in hbmorrison.h.
+
+ACTION_APP_1 = 0
+ACTION_APP_2 = 1
+ACTION_APP_3 = 2
+ACTION_APP_4 = 3
+ACTION_APP_5 = 4
+ACTION_MINIMISE = 5
+ACTION_MAXIMISE = 6
+ACTION_CLOSE = 7
+
+# Apps to switch to, as the window class to look for and the command to run if
+# no window is found.
+
+APPS = {
+    ACTION_APP_1: ("google-chrome", "google-chrome"),
+    ACTION_APP_2: ("gnome-terminal-server", "gnome-terminal"),
+    ACTION_APP_3: ("teams-for-linux", "teams-for-linux"),
+    ACTION_APP_4: ("org.gnome.Nautilus", "nautilus"),
+    ACTION_APP_5: ("remmina", "remmina"),
+}
+
+WINDOW_COMMANDS = {
+    ACTION_MINIMISE: "xdotool getactivewindow windowminimize",
+    ACTION_MAXIMISE: "wmctrl -r :ACTIVE: -b toggle,maximized_vert,maximized_horz",
+    ACTION_CLOSE: "wmctrl -c :ACTIVE:",
+}
+
+
+def run(command, dry_run):
+    if dry_run:
+        print(command, flush=True)
+        return 0
+    return subprocess.call(shlex.split(command))
+
+
+def perform(action, dry_run):
+    if action in APPS:
+        wm_class, launch = APPS[action]
+        if run("wmctrl -x -a " + wm_class, dry_run) != 0:
+            subprocess.Popen(shlex.split(launch), start_new_session=True)
+    elif action in WINDOW_COMMANDS:
+        run(WINDOW_COMMANDS[action], dry_run)
+    else:
+        print("Unknown action {}".format(action), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Carry out window actions sent by the keyboard.")
+    source = parser.add_mutually_exclusive_group()
+    source.add_argument("--device", help="hidraw device, found automatically by default")
+    source.add_argument("--socket", help="read reports from a Unix datagram socket instead")
+    parser.add_argument("--dry-run", action="store_true", help="print commands instead of running them")
+    args = parser.parse_args()
+
+    if args.socket:
+        if os.path.exists(args.socket):
+            os.unlink(args.socket)
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        sock.bind(args.socket)
+        read = lambda: sock.recv(REPORT_SIZE)
+    else:
+        fd = os.open(args.device or find_device(), os.O_RDONLY)
+        read = lambda: os.read(fd, REPORT_SIZE)
+
+    while True:
+        report = read()
+        if len(report) >= 2 and report[0] == HID_ACTION:
+            perform(report[1], args.dry_run)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+
+# Get and set the keyboard's runtime settings over raw HID.
+#
+# Usage:
+#
+#   hbm_tune.py [--device PATH] [--timeout SECONDS] get [SETTING]
+#   hbm_tune.py [--device PATH] [--timeout SECONDS] set SETTING VALUE
+#   hbm_tune.py [--device PATH] [--timeout SECONDS] save
+#   hbm_tune.py [--device PATH] [--timeout SECONDS] reset
+#
+# Settings take effect as soon as they are set but are only kept across a
+# restart once saved. Key set settings take a comma separated list of keys,
+# for example: set retro_tapping_keys lt_nav,lt_num,hr_lgui. The keyboard
+# rejects values outside the range it allows for each setting.
+
+import argparse
+import glob
+import os
+import select
+import sys
+
+# These must match hbm_settings, hbm_tunable_keys and hbm_hid_commands in
+# hbmorrison.h.
+
+CONFIG_VERSION = 2
+
+SETTINGS = [
+    "tapping_term_layer",
+    "tapping_term_homerow",
+    "tapping_term_homerow_gui",
+    "caps_word_idle_timeout",
+    "permissive_hold_keys",
+    "retro_tapping_keys",
+]
+
+KEY_SET_SETTINGS = ["permissive_hold_keys", "retro_tapping_keys"]
+
+TUNABLE_KEYS = [
+    "lt_lsym",
+    "lt_rsym",
+    "lt_nav",
+    "lt_num",
+    "lt_func",
+    "lt_ctls",
+    "hr_lgui",
+    "hr_lalt",
+    "hr_lctl",
+    "hr_lca",
+    "hr_rca",
+    "hr_rctl",
+    "hr_ralt",
+    "hr_rgui",
+]
+
+HID_GET_VERSION = 0x01
+HID_GET_SETTING = 0x02
+HID_SET_SETTING = 0x03
+HID_SAVE_SETTINGS = 0x04
+HID_RESET_SETTINGS = 0x05
+HID_ACTION = 0x10
+
+HID_STATUS_OK = 0
+
+# Settings are sent as 16 bit numbers.
+
+MAX_VALUE = 0xFFFF
+
+REPORT_SIZE = 32
+
+# How long to wait for the keyboard to answer a request, in seconds.
+
+DEFAULT_TIMEOUT = 2.0
+
+# The QMK raw HID usage page and usage, as they appear in the report descriptor.
+
+RAW_HID_USAGE = bytes([0x06, 0x60, 0xFF, 0x09, 0x61])
+
+
+def find_device():
+    for path in sorted(glob.glob("/sys/class/hidraw/hidraw*")):
+        try:
+            with open(os.path.join(path, "device", "report_descriptor"), "rb") as f:
+                if f.read().startswith(RAW_HID_USAGE):
+                    return os.path.join("/dev", os.path.basename(path))
+        except OSError:
+            pass
+    sys.exit("Error: no raw HID keyboard found - use --device to select one")
+
+
+def read_report(fd, timeout):
+    report = b""
+    while len(report) < REPORT_SIZE:
+        if not select.select([fd], [], [], timeout)[0]:
+            sys.exit("Error: no response from keyboard after {} seconds".format(timeout))
+        data = os.read(fd, REPORT_SIZE - len(report))
+        if not data:
+            sys.exit("Error: keyboard disconnected")
+        report += data
+    return report
+
+
+def request(fd, command, setting=0, value=0, timeout=DEFAULT_TIMEOUT):
+    report = bytes([command, setting, value & 0xFF, value >> 8])
+    os.write(fd, b"\x00" + report.ljust(REPORT_SIZE, b"\x00"))
+    response = read_report(fd, timeout)
+    # Skip any window actions sent by the keyboard in the meantime.
+    while response[:1] == bytes([HID_ACTION]):
+        response = read_report(fd, timeout)
+    if len(response) < 5 or response[0] != command or response[4] != HID_STATUS_OK:
+        if command == HID_SET_SETTING:
+            sys.exit("Error: keyboard rejected {} for {} - value out of range".format(value, SETTINGS[setting]))
+        sys.exit("Error: keyboard rejected command {:#04x}".format(command))
+    return response[2] | (response[3] << 8)
+
+
+def format_value(name, value):
+    if name in KEY_SET_SETTINGS:
+        return ",".join(k for i, k in enumerate(TUNABLE_KEYS) if value & (1 << i))
+    return str(value)
+
+
+def parse_value(name, text):
+    if name not in KEY_SET_SETTINGS:
+        try:
+            value = int(text, 0)
+        except ValueError:
+            sys.exit("Error: {} is not a number".format(text))
+        if not 0 <= value <= MAX_VALUE:
+            sys.exit("Error: {} is out of range - expected 0 to {}".format(value, MAX_VALUE))
+        return value
+    value = 0
+    for key in filter(None, text.lower().split(",")):
+        if key not in TUNABLE_KEYS:
+            sys.exit("Error: unknown key {} - expected one of {}".format(key, ", ".join(TUNABLE_KEYS)))
+        value |= 1 << TUNABLE_KEYS.index(key)
+    return value
+
+
+def setting_id(name):
+    if name not in SETTINGS:
+        sys.exit("Error: unknown setting {} - expected one of {}".format(name, ", ".join(SETTINGS)))
+    return SETTINGS.index(name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Tune keyboard settings over raw HID.")
+    parser.add_argument("--device", help="hidraw device, found automatically by default")
+    parser.add_argument("--timeout", type=float, default=DEFAULT_TIMEOUT,
+                        help="seconds to wait for each response (default %(default)s)")
+    commands = parser.add_subparsers(dest="command", required=True)
+    get = commands.add_parser("get", help="show one or all settings")
+    get.add_argument("setting", nargs="?")
+    set_ = commands.add_parser("set", help="change a setting until restart")
+    set_.add_argument("setting")
+    set_.add_argument("value")
+    commands.add_parser("save", help="store the current settings in EEPROM")
+    commands.add_parser("reset", help="restore and store the default settings")
+    args = parser.parse_args()
+
+    fd = os.open(args.device or find_device(), os.O_RDWR)
+
+    version = request(fd, HID_GET_VERSION, timeout=args.timeout)
+    if version != CONFIG_VERSION:
+        sys.exit("Error: keyboard settings version {} is not supported".format(version))
+
+    if args.command == "get":
+        names = [args.setting] if args.setting else SETTINGS
+        for name in names:
+            value = request(fd, HID_GET_SETTING, setting_id(name), timeout=args.timeout)
+            print("{} = {}".format(name, format_value(name, value)))
+    elif args.command == "set":
+        request(fd, HID_SET_SETTING, setting_id(args.setting), parse_value(args.setting, args.value),
+                timeout=args.timeout)
+    elif args.command == "save":
+        request(fd, HID_SAVE_SETTINGS, timeout=args.timeout)
+    elif args.command == "reset":
+        request(fd, HID_RESET_SETTINGS, timeout=args.timeout)
+
+    os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -16,9 +16,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "hbmorrison.h"
+#include "debounce.h"
+#include "raw_hid.h"
 
 bool process_homerow_mod(uint16_t tap, uint16_t hold, uint16_t second_hold, keyrecord_t *record);
-bool process_rsft_mod(keyrecord_t *record);
+bool process_shift_mod(uint8_t oneshot_mod, keyrecord_t *record);
+void del_sent_oneshot_mods(uint8_t mods);
+bool process_leader(uint16_t keycode, keyrecord_t *record);
+void leader_start(void);
+void alt_tab_press(uint8_t mod_state);
+void alt_tab_release(void);
+void alt_tab_idle(void);
+bool process_mouse_key(uint16_t keycode, keyrecord_t *record);
+void process_nav_repeat(uint16_t keycode, keyrecord_t *record);
+void macro_stop_recording(void);
+void macro_save(void);
+void macro_toggle_recording(void);
+void macro_play(void);
+bool process_combos(uint16_t keycode, keyrecord_t *record);
+void combo_init(void);
+void combo_flush(void);
+void send_action(uint8_t action);
+uint16_t tunable_key_bit(uint16_t keycode);
 bool process_record_user_windows(uint16_t keycode, keyrecord_t *record);
 bool process_record_user_chromeos(uint16_t keycode, keyrecord_t *record);
 bool process_record_user_linux(uint16_t keycode, keyrecord_t *record);
@@ -37,6 +56,8 @@ bool rgui_held = false;
 bool rca_held = false;
 
 // Stores the state of the shift keys when in layers higher than the base layer.
+// Shift is accumulated so that a second keypress on a symbol layer does not
+// lose the shift state saved by the first.
 
 static uint8_t sym_layer_shift_mods = 0;
 
@@ -48,6 +69,368 @@ static bool del_registered = false;
 
 static bool alt_tab_state = false;
 
+// True if tabbing backwards between windows, the current interval between
+// repeated tabs, and the tokens for the repeat and idle timers.
+
+static bool alt_tab_reverse = false;
+static uint16_t alt_tab_interval = ALT_TAB_REPEAT_INTERVAL;
+static deferred_token alt_tab_repeat_token = INVALID_DEFERRED_TOKEN;
+static deferred_token alt_tab_idle_token = INVALID_DEFERRED_TOKEN;
+
+// Leader key sequences are stored as a trie. Each node has a child for each
+// alpha key, indexed by the keycode's offset from KC_A, so that each key in a
+// sequence is a single lookup. A child of zero means there is no child, since
+// the root is never a child. Leaf nodes are sent as soon as they are reached,
+// other nodes with an action are sent when the leader timeout expires.
+
+enum leader_nodes {
+  LN_ROOT,
+  LN_D,
+  LN_DN,
+  LN_DP,
+  LN_E,
+  LN_F,
+  LN_M,
+  LN_O,
+  LN_S,
+  LN_SC,
+  LN_SL,
+  LN_SW,
+  LN_INACTIVE = 0xFF
+};
+
+typedef struct {
+  uint8_t children[KC_Z - KC_A + 1];
+  uint16_t action;
+  bool leaf;
+} leader_node_t;
+
+#define LEADER_KEY(kc) [(kc) - KC_A]
+#define LEADER_NODE(act, ...) { .children = { __VA_ARGS__ }, .action = act, .leaf = false }
+#define LEADER_LEAF(act) { .children = { 0 }, .action = act, .leaf = true }
+
+static const leader_node_t PROGMEM leader_trie[] = {
+  [LN_ROOT] = LEADER_NODE(KC_NO,
+    LEADER_KEY(KC_D) = LN_D,
+    LEADER_KEY(KC_E) = LN_E,
+    LEADER_KEY(KC_F) = LN_F,
+    LEADER_KEY(KC_M) = LN_M,
+    LEADER_KEY(KC_O) = LN_O,
+    LEADER_KEY(KC_S) = LN_S),
+
+  // Desktops.
+
+  [LN_D] = LEADER_NODE(KC_NO,
+    LEADER_KEY(KC_N) = LN_DN,
+    LEADER_KEY(KC_P) = LN_DP),
+  [LN_DN] = LEADER_LEAF(M_NDESK),
+  [LN_DP] = LEADER_LEAF(M_PDESK),
+  [LN_O] = LEADER_LEAF(M_OVERVIEW),
+
+  // Windows.
+
+  [LN_F] = LEADER_LEAF(M_FULLSCREEN),
+  [LN_M] = LEADER_LEAF(M_MINIMISE),
+  [LN_E] = LEADER_LEAF(M_EMOJI),
+
+  // Operating system selection.
+
+  [LN_S] = LEADER_NODE(KC_NO,
+    LEADER_KEY(KC_C) = LN_SC,
+    LEADER_KEY(KC_L) = LN_SL,
+    LEADER_KEY(KC_W) = LN_SW),
+  [LN_SC] = LEADER_LEAF(M_ISCHROMEOS),
+  [LN_SL] = LEADER_LEAF(M_ISLINUX),
+  [LN_SW] = LEADER_LEAF(M_ISWINDOWS)
+};
+
+// A recorded macro. Each event is a byte with the top bit set if the key was
+// pressed and clear if it was released. The rest of the byte is the key's
+// keycode, or MACRO_MODS plus the modifier's bit for the eight modifiers. Every
+// key in the keymap and sent by the userspace is below MACRO_MODS, and any key
+// above it is left out of the macro.
+
+#define MACRO_PRESSED 0x80
+#define MACRO_MODS 0x78
+
+typedef struct {
+  uint8_t length;
+  uint8_t events[MACRO_SIZE];
+} __attribute__((packed)) macro_t;
+
+// Room kept at the end of the macro for releasing every key and modifier that
+// can be held, so that a macro that fills up still ends with nothing held.
+
+#define MACRO_RELEASE_RESERVE (KEYBOARD_REPORT_KEYS + 8)
+
+_Static_assert(MACRO_SIZE > MACRO_RELEASE_RESERVE, "MACRO_SIZE is too small");
+
+// Runtime settings, read from EEPROM at startup. The recorded macro is stored
+// after them if it is persisted. The settings are padded to HBM_SETTINGS_SIZE
+// so that more can be added without moving the macro, and the whole config is
+// the size of the datablock since QMK always reads and writes all of it.
+
+typedef struct {
+  uint8_t version;
+  uint16_t settings[SETTING_COUNT];
+  uint8_t reserved[HBM_SETTINGS_SIZE - 1 - 2 * SETTING_COUNT];
+#ifdef MACRO_PERSIST
+  macro_t macro;
+#endif
+} __attribute__((packed)) hbm_config_t;
+
+_Static_assert(sizeof(hbm_config_t) == EECONFIG_USER_DATA_SIZE, "EECONFIG_USER_DATA_SIZE does not match hbm_config_t");
+
+static hbm_config_t hbm_config;
+
+#ifdef MACRO_PERSIST
+static macro_t *const recorded_macro = &hbm_config.macro;
+#else
+static macro_t macro_arena;
+static macro_t *const recorded_macro = &macro_arena;
+#endif
+
+// True while recording or playing the macro, or if recording stopped because
+// the macro was full, the last keyboard report seen while recording, and the
+// position while playing.
+
+static bool macro_recording = false;
+static bool macro_playing = false;
+static bool macro_overflowed = false;
+static report_keyboard_t macro_last_report;
+static uint8_t macro_position = 0;
+
+// Time in milliseconds between replayed events for each operating system. This
+// is the fastest rate at which each reliably sees every event.
+
+static const uint8_t PROGMEM macro_play_intervals[] = {
+  [OS_WINDOWS] = MACRO_PLAY_INTERVAL_WINDOWS,
+  [OS_CHROMEOS] = MACRO_PLAY_INTERVAL_CHROMEOS,
+  [OS_LINUX] = MACRO_PLAY_INTERVAL_LINUX
+};
+
+// The host driver is wrapped so that the keyboard reports that are actually
+// sent can be recorded.
+
+static host_driver_t *hbm_original_driver = NULL;
+static host_driver_t hbm_driver;
+
+#define TK_BIT(key) (1 << (key))
+
+static const uint16_t PROGMEM hbm_default_settings[SETTING_COUNT] = {
+  [SETTING_TAPPING_TERM_LAYER] = TAPPING_TERM_LAYER,
+  [SETTING_TAPPING_TERM_HOMEROW] = TAPPING_TERM_HOMEROW,
+  [SETTING_TAPPING_TERM_HOMEROW_GUI] = TAPPING_TERM_HOMEROW_GUI,
+  [SETTING_CAPS_WORD_IDLE_TIMEOUT] = CAPS_WORD_IDLE_TIMEOUT_USER,
+
+  // All tap-hold keys except alt and gui get permissive hold.
+
+  [SETTING_PERMISSIVE_HOLD_KEYS] = TK_BIT(TK_LT_LSYM) | TK_BIT(TK_LT_RSYM) |
+    TK_BIT(TK_LT_NAV) | TK_BIT(TK_LT_NUM) | TK_BIT(TK_LT_FUNC) |
+    TK_BIT(TK_LT_CTLS) | TK_BIT(TK_HR_LCTL) | TK_BIT(TK_HR_LCA) |
+    TK_BIT(TK_HR_RCA) | TK_BIT(TK_HR_RCTL),
+
+  // Only the space, enter, alt and gui keys get retro tapping.
+
+  [SETTING_RETRO_TAPPING_KEYS] = TK_BIT(TK_LT_NAV) | TK_BIT(TK_LT_NUM) |
+    TK_BIT(TK_HR_LGUI) | TK_BIT(TK_HR_LALT) | TK_BIT(TK_HR_RALT) |
+    TK_BIT(TK_HR_RGUI)
+};
+
+// The lowest and highest values that each setting can be set to over raw HID.
+// Tapping terms are in milliseconds, and a caps word idle timeout of zero turns
+// the idle timeout off. Key sets can have any of the tunable keys.
+
+typedef struct {
+  uint16_t min;
+  uint16_t max;
+} setting_range_t;
+
+static const setting_range_t PROGMEM hbm_setting_ranges[SETTING_COUNT] = {
+  [SETTING_TAPPING_TERM_LAYER] = { TAPPING_TERM_MIN, TAPPING_TERM_MAX },
+  [SETTING_TAPPING_TERM_HOMEROW] = { TAPPING_TERM_MIN, TAPPING_TERM_MAX },
+  [SETTING_TAPPING_TERM_HOMEROW_GUI] = { TAPPING_TERM_MIN, TAPPING_TERM_MAX },
+  [SETTING_CAPS_WORD_IDLE_TIMEOUT] = { 0, CAPS_WORD_IDLE_TIMEOUT_MAX },
+  [SETTING_PERMISSIVE_HOLD_KEYS] = { 0, TK_BIT(TK_COUNT) - 1 },
+  [SETTING_RETRO_TAPPING_KEYS] = { 0, TK_BIT(TK_COUNT) - 1 }
+};
+
+// Records when caps word was last used, for the caps word idle timeout.
+
+static uint16_t caps_word_timer = 0;
+
+// Caps word modes, selected by the number of taps on either shift key. Each
+// mode sets whether alpha keys are shifted and what space is replaced with.
+// Space ends SHOUTING_CASE, and in camelCase it is dropped and the next alpha
+// key is shifted instead.
+
+enum caps_word_modes {
+  CW_SHOUTING_CASE,
+  CW_SNAKE_CASE,
+  CW_KEBAB_CASE,
+  CW_CAMEL_CASE,
+  CW_MODE_COUNT
+};
+
+typedef struct {
+  bool shift_alphas;
+  uint16_t space;
+} caps_word_mode_t;
+
+static const caps_word_mode_t caps_word_modes[CW_MODE_COUNT] = {
+  [CW_SHOUTING_CASE] = { .shift_alphas = true, .space = KC_SPC },
+  [CW_SNAKE_CASE] = { .shift_alphas = false, .space = KC_UNDS },
+  [CW_KEBAB_CASE] = { .shift_alphas = false, .space = KC_MINS },
+  [CW_CAMEL_CASE] = { .shift_alphas = false, .space = KC_NO }
+};
+
+static uint8_t caps_word_mode = CW_SHOUTING_CASE;
+static bool caps_word_shift_next = false;
+
+// The current node in the leader trie, and the token for the leader timeout.
+
+static uint8_t leader_node = LN_INACTIVE;
+static deferred_token leader_token = INVALID_DEFERRED_TOKEN;
+
+// The keys whose presses were consumed by the leader sequence and whose
+// releases must be dropped, and whether the leader is sending its action.
+
+static matrix_row_t leader_consumed[MATRIX_ROWS];
+static bool leader_sending = false;
+
+// The navigation key currently being repeated, whether it is currently pressed
+// on the host, the current interval between steps, and the repeat timer token.
+
+static uint16_t nav_repeat_keycode = KC_NO;
+static bool nav_repeat_down = false;
+static uint16_t nav_repeat_interval = NAV_REPEAT_INTERVAL;
+static deferred_token nav_repeat_token = INVALID_DEFERRED_TOKEN;
+
+// Pointer and wheel speeds in 8.8 fixed point pixels or wheel steps per
+// MOUSE_INTERVAL, indexed by the time in 8ms units since movement started. The
+// speeds follow a quadratic ramp so that short taps give fine control.
+//
+// The wheel moves in whole wheel steps. High resolution scrolling would need
+// the pointing device feature with POINTING_DEVICE_HIRES_SCROLL_ENABLE, which
+// adds a resolution multiplier to the mouse descriptor, and that is not used
+// here. Scrolling is smoothed only by carrying the fraction of a step over to
+// the next report.
+
+#define MOUSE_CURVE_LENGTH 64
+
+static const uint16_t PROGMEM mouse_speed_curve[MOUSE_CURVE_LENGTH] = {
+    64,   64,   66,   68,   72,   76,   82,   88,
+    96,  104,  114,  124,  136,  148,  162,  176,
+   192,  208,  226,  244,  264,  284,  306,  328,
+   352,  376,  402,  428,  456,  484,  514,  544,
+   576,  608,  642,  676,  712,  748,  786,  824,
+   864,  904,  946,  988, 1032, 1076, 1122, 1168,
+  1216, 1264, 1314, 1364, 1416, 1468, 1522, 1576,
+  1632, 1688, 1746, 1804, 1864, 1924, 1986, 2048
+};
+
+static const uint16_t PROGMEM wheel_speed_curve[MOUSE_CURVE_LENGTH] = {
+     5,    5,    5,    5,    5,    5,    6,    6,
+     6,    6,    6,    7,    7,    7,    7,    8,
+     8,    8,    9,    9,   10,   10,   11,   11,
+    12,   12,   13,   14,   14,   15,   16,   16,
+    17,   18,   19,   19,   20,   21,   22,   23,
+    24,   25,   26,   27,   28,   29,   30,   31,
+    32,   33,   34,   35,   37,   38,   39,   40,
+    42,   43,   44,   46,   47,   48,   50,   51
+};
+
+// Mouse directions that are currently held.
+
+enum mouse_directions {
+  MOUSE_LEFT = 1 << 0,
+  MOUSE_RIGHT = 1 << 1,
+  MOUSE_UP = 1 << 2,
+  MOUSE_DOWN = 1 << 3,
+  WHEEL_LEFT = 1 << 4,
+  WHEEL_RIGHT = 1 << 5,
+  WHEEL_UP = 1 << 6,
+  WHEEL_DOWN = 1 << 7
+};
+
+#define MOUSE_POINTER (MOUSE_LEFT | MOUSE_RIGHT | MOUSE_UP | MOUSE_DOWN)
+#define MOUSE_WHEEL (WHEEL_LEFT | WHEEL_RIGHT | WHEEL_UP | WHEEL_DOWN)
+
+static uint8_t mouse_directions = 0;
+
+// The fractions of a pixel or wheel step carried over to the next report for
+// the x, y, vertical wheel and horizontal wheel axes.
+
+enum mouse_axes {
+  AXIS_X,
+  AXIS_Y,
+  AXIS_V,
+  AXIS_H,
+  AXIS_COUNT
+};
+
+static uint8_t mouse_fractions[AXIS_COUNT];
+
+// When the pointer and wheel started moving, and the token for the movement
+// timer.
+
+static uint16_t mouse_timer = 0;
+static uint16_t wheel_timer = 0;
+static deferred_token mouse_token = INVALID_DEFERRED_TOKEN;
+
+// Combos on the base layer. Each combo is a set of up to COMBO_MAX_KEYS base
+// layer keys that are pressed together to send the output instead. The keys are
+// given as basic keycodes and converted to a bitmask of matrix positions at
+// startup. A combo must not have all of the keys of another combo, since a
+// combo is sent as soon as all of its keys are pressed.
+
+#define COMBO_MAX_KEYS 3
+
+typedef uint64_t combo_mask_t;
+
+_Static_assert(MATRIX_ROWS * MATRIX_COLS <= sizeof(combo_mask_t) * 8, "combo_mask_t is too small");
+
+typedef struct {
+  uint16_t keys[COMBO_MAX_KEYS];
+  uint16_t output;
+} hbm_combo_t;
+
+static const hbm_combo_t PROGMEM hbm_combos[] = {
+  { { KC_W, KC_R }, UK_DQUO },
+  { { KC_P, KC_T }, KC_LPRN },
+  { { KC_B, KC_G }, KC_RPRN },
+  { { KC_J, KC_M }, KC_MINS },
+  { { KC_L, KC_N }, KC_EQL },
+  { { KC_Y, KC_I }, KC_UNDS }
+};
+
+#define COMBO_COUNT (sizeof(hbm_combos) / sizeof(hbm_combos[0]))
+
+static combo_mask_t combo_masks[COMBO_COUNT];
+
+// All keys that are part of a combo, the combo keys that are pressed and held
+// back while waiting to see if they form a combo, and the keys that formed a
+// combo and whose releases must be dropped.
+
+static combo_mask_t combo_keys = 0;
+static combo_mask_t combo_pressed = 0;
+static combo_mask_t combo_consumed = 0;
+
+// The held back keypresses in the order they were pressed, with their keycodes
+// and the weak modifiers that caps word gave them, the token for the combo
+// timeout, and whether the held back keypresses are being processed.
+
+typedef struct {
+  keyrecord_t record;
+  uint16_t keycode;
+  uint8_t weak_mods;
+} combo_press_t;
+
+static combo_press_t combo_buffer[COMBO_MAX_KEYS];
+static uint8_t combo_buffer_length = 0;
+static deferred_token combo_token = INVALID_DEFERRED_TOKEN;
+static bool combo_flushing = false;
+
 // Process keypresses.
 
 bool process_record_user(uint16_t keycode, keyrecord_t *record) {
@@ -57,6 +440,20 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
   uint8_t mod_state = get_mods();
   uint8_t highest_layer = get_highest_layer(layer_state);
 
+  // Keypresses that follow the leader key are consumed by the leader sequence,
+  // and the rest may form combos. The keypress sent by the leader for its
+  // action is not a real key, so it is neither.
+
+  if (! leader_sending) {
+
+    if (! process_leader(keycode, record))
+      return false;
+
+    if (! process_combos(keycode, record))
+      return false;
+
+  }
+
   // Only allow left hand modifiers to work with the right hand side of the
   // keyboard and vice versa.
 
@@ -91,8 +488,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
         // If a left shift oneshot modifier is active, clear it.
 
-        if (get_oneshot_mods() & MOD_BIT(KC_LSFT))
-          del_oneshot_mods(MOD_BIT(KC_LSFT));
+        del_sent_oneshot_mods(MOD_BIT(KC_LSFT));
 
         // If a left hand modifier is being held, remove the mods, tap the key
         // unmodded, then reinstate the mods.
@@ -133,8 +529,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
         // If a right shift oneshot modifier is active, clear it.
 
-        if (get_oneshot_mods() & MOD_BIT(KC_RSFT))
-          del_oneshot_mods(MOD_BIT(KC_RSFT));
+        del_sent_oneshot_mods(MOD_BIT(KC_RSFT));
 
         // If a right hand modifier is being held, remove the mods, tap the key
         // unmodded, then reinstate the mods.
@@ -157,9 +552,9 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
   if (highest_layer == LAYER_LSYM || highest_layer == LAYER_RSYM) {
     if (record->event.pressed) {
 
-      sym_layer_shift_mods = get_mods() & MOD_MASK_SHIFT;
+      sym_layer_shift_mods |= get_mods() & MOD_MASK_SHIFT;
       del_mods(MOD_MASK_SHIFT);
-      del_oneshot_mods(MOD_MASK_SHIFT);
+      del_sent_oneshot_mods(MOD_MASK_SHIFT);
 
     } else {
 
@@ -172,11 +567,10 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
   }
 
   // Stop pressing the KC_LALT key once M_ALT_TAB is no longer being pressed.
+  // The shift keys are allowed so that they can reverse the direction.
 
-  if (keycode != M_ALT_TAB && alt_tab_state) {
-    unregister_code(KC_LALT);
-    alt_tab_state = false;
-  }
+  if (keycode != M_ALT_TAB && keycode != OSM_LSFT && keycode != OSM_RSFT && alt_tab_state)
+    alt_tab_release();
 
   // Override each right hand homerow modifier key so that we can record when it
   // is being held. We avoid processing the homerow modifier keys if the tap
@@ -208,11 +602,15 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 
   switch (keycode) {
 
-    // The right shift modifier is handled separately from the homerow modifiers
+    // The shift modifiers are handled separately from the homerow modifiers
     // above so that we can detect double taps for toggling caps word.
 
+    case OSM_LSFT:
+      process_shift_mod(MOD_BIT(KC_LSFT), record);
+      return false;
+
     case OSM_RSFT:
-      rsft_held = process_rsft_mod(record);
+      rsft_held = process_shift_mod(MOD_BIT(KC_RSFT), record);
       return false;
 
     // Shift-backspace produces delete.
@@ -235,22 +633,79 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
       }
       break;
 
+    // Replace space when caps word is joining words. Caps word has already
+    // seen the space, and has ended if the current mode does not join words.
+
+    case LT_NAV:
+      if (record->event.pressed && record->tap.count && is_caps_word_on()) {
+        uint16_t space = caps_word_modes[caps_word_mode].space;
+        if (space == KC_NO)
+          caps_word_shift_next = true;
+        else
+          tap_code16(space);
+        return false;
+      }
+      break;
+
+    // Repeat the navigation keys while they are held.
+
+    case KC_LEFT:
+    case KC_DOWN:
+    case KC_UP:
+    case KC_RIGHT:
+    case KC_HOME:
+    case KC_PGDN:
+    case KC_PGUP:
+    case KC_END:
+      process_nav_repeat(keycode, record);
+      break;
+
+    // Move the pointer and scroll.
+
+    case KC_MS_UP:
+    case KC_MS_DOWN:
+    case KC_MS_LEFT:
+    case KC_MS_RIGHT:
+    case KC_MS_WH_UP:
+    case KC_MS_WH_DOWN:
+    case KC_MS_WH_LEFT:
+    case KC_MS_WH_RIGHT:
+      return process_mouse_key(keycode, record);
+
     // Hold down the ALT key persistently when tabbing through windows.
 
     case M_ALT_TAB:
-      if (record->event.pressed) {
-        if (! alt_tab_state) {
-          register_code(KC_LALT);
-          alt_tab_state = true;
-        }
-        tap_code(KC_TAB);
-      }
+      if (record->event.pressed)
+        alt_tab_press(mod_state);
+      else
+        alt_tab_idle();
       break;
 
     // Send Escape then Colon.
 
     case M_ESC_COLN:
-      SEND_STRING(SS_TAP(X_ESC) SS_DELAY(100) ":");
+      if (record->event.pressed) {
+        SEND_STRING(SS_TAP(X_ESC) SS_DELAY(100) ":");
+      }
+      break;
+
+    // Start a leader sequence.
+
+    case M_LEADER:
+      if (record->event.pressed)
+        leader_start();
+      break;
+
+    // Record and play back a macro.
+
+    case M_MACRO_REC:
+      if (record->event.pressed)
+        macro_toggle_recording();
+      break;
+
+    case M_MACRO_PLAY:
+      if (record->event.pressed)
+        macro_play();
       break;
 
     // Swap between Windows, ChromeOS and Linux shortcuts.
@@ -318,10 +773,10 @@ bool process_homerow_mod(uint16_t tap, uint16_t hold, uint16_t second_hold, keyr
   return false;
 }
 
-// Process the right shift modifier key and return true if the key is currently
-// being held.
+// Process a shift modifier key, which becomes the given oneshot modifier when
+// tapped, and return true if the key is currently being held.
 
-bool process_rsft_mod(keyrecord_t *record) {
+bool process_shift_mod(uint8_t oneshot_mod, keyrecord_t *record) {
 
   if (record->event.pressed) {
 
@@ -332,14 +787,696 @@ bool process_rsft_mod(keyrecord_t *record) {
 
     unregister_code(KC_LSFT);
 
+    // Shift was released while a symbol layer key had it saved, so the saved
+    // shift must not be restored when that key is released.
+
+    sym_layer_shift_mods &= ~MOD_BIT(KC_LSFT);
+
     if (record->tap.count == 1)
-      add_oneshot_mods(MOD_BIT(KC_RSFT));
+      add_oneshot_mods(oneshot_mod);
 
-    if (record->tap.count > 1)
+    // Double tapping toggles SHOUTING_CASE, and each further tap moves on to
+    // the next caps word mode.
+
+    if (record->tap.count == 2) {
+      caps_word_mode = CW_SHOUTING_CASE;
       caps_word_toggle();
+    }
+
+    if (record->tap.count > 2) {
+      caps_word_mode = MIN(record->tap.count - 2, CW_MODE_COUNT - 1);
+      caps_word_on();
+    }
+
+  }
+
+  return false;
+}
+
+// Clear oneshot modifiers. A oneshot modifier goes out with every report sent
+// while it is active, so if it has already gone out in a report with no keys,
+// send another without it in case the key being processed sends none.
+
+void del_sent_oneshot_mods(uint8_t mods) {
+
+  bool sent = keyboard_report->mods & get_oneshot_mods() & mods;
+
+  del_oneshot_mods(mods);
+
+  if (sent)
+    send_keyboard_report();
+
+}
+
+// Tab to the next window, or the previous window if shift was held or oneshot
+// shift was active when M_ALT_TAB was pressed. Shift is only added here if it
+// is not already being held.
+
+void alt_tab_tap(void) {
+  if (alt_tab_reverse && ! (get_mods() & MOD_MASK_SHIFT))
+    tap_code16(LSFT(KC_TAB));
+  else
+    tap_code(KC_TAB);
+}
+
+// Repeat tabbing while M_ALT_TAB is held, speeding up with each repeat.
+
+uint32_t alt_tab_repeat(uint32_t trigger_time, void *cb_arg) {
+
+  alt_tab_tap();
+
+  if (alt_tab_interval > ALT_TAB_REPEAT_MIN_INTERVAL + ALT_TAB_REPEAT_ACCEL)
+    alt_tab_interval -= ALT_TAB_REPEAT_ACCEL;
+  else
+    alt_tab_interval = ALT_TAB_REPEAT_MIN_INTERVAL;
+
+  return alt_tab_interval;
+}
+
+uint32_t alt_tab_timeout(uint32_t trigger_time, void *cb_arg) {
+  alt_tab_idle_token = INVALID_DEFERRED_TOKEN;
+  alt_tab_release();
+  return 0;
+}
+
+// Hold down the ALT key persistently, tab once, then start repeating. Windows,
+// ChromeOS and Linux all use Alt-Tab and Shift-Alt-Tab to cycle windows.
+
+void alt_tab_press(uint8_t mod_state) {
+
+  alt_tab_reverse = (mod_state | get_oneshot_mods()) & MOD_MASK_SHIFT;
+  del_oneshot_mods(MOD_MASK_SHIFT);
+
+  if (! alt_tab_state) {
+    register_code(KC_LALT);
+    alt_tab_state = true;
+  }
+
+  cancel_deferred_exec(alt_tab_idle_token);
+  cancel_deferred_exec(alt_tab_repeat_token);
+  alt_tab_idle_token = INVALID_DEFERRED_TOKEN;
+
+  alt_tab_tap();
+
+  alt_tab_interval = ALT_TAB_REPEAT_INTERVAL;
+  alt_tab_repeat_token = defer_exec(ALT_TAB_REPEAT_DELAY, alt_tab_repeat, NULL);
+
+}
+
+// Stop repeating once M_ALT_TAB is released and let go of the ALT key if it
+// is not pressed again within the idle timeout.
+
+void alt_tab_idle(void) {
+
+  cancel_deferred_exec(alt_tab_repeat_token);
+  alt_tab_repeat_token = INVALID_DEFERRED_TOKEN;
+
+  if (alt_tab_state && alt_tab_idle_token == INVALID_DEFERRED_TOKEN)
+    alt_tab_idle_token = defer_exec(ALT_TAB_IDLE_TIMEOUT, alt_tab_timeout, NULL);
+
+}
+
+void alt_tab_release(void) {
+
+  cancel_deferred_exec(alt_tab_repeat_token);
+  cancel_deferred_exec(alt_tab_idle_token);
+  alt_tab_repeat_token = INVALID_DEFERRED_TOKEN;
+  alt_tab_idle_token = INVALID_DEFERRED_TOKEN;
+
+  unregister_code(KC_LALT);
+  alt_tab_state = false;
+
+}
+
+// Repeat the held navigation key. Each step either releases or presses the key
+// so that it costs a single report, and the interval shrinks after each press.
+
+uint32_t nav_repeat(uint32_t trigger_time, void *cb_arg) {
+
+  if (nav_repeat_down) {
+    unregister_code(nav_repeat_keycode);
+  } else {
+    register_code(nav_repeat_keycode);
+    if (nav_repeat_interval > NAV_REPEAT_MIN_INTERVAL + NAV_REPEAT_ACCEL)
+      nav_repeat_interval -= NAV_REPEAT_ACCEL;
+    else
+      nav_repeat_interval = NAV_REPEAT_MIN_INTERVAL;
+  }
+
+  nav_repeat_down = ! nav_repeat_down;
+
+  return nav_repeat_interval;
+}
+
+// Start repeating when a navigation key is pressed and stop when it is
+// released. The key itself is registered and unregistered by QMK as usual, and
+// the repeats are sent directly so they are not seen as keypresses by the
+// tapping code.
+
+void process_nav_repeat(uint16_t keycode, keyrecord_t *record) {
+
+  if (record->event.pressed) {
+
+    cancel_deferred_exec(nav_repeat_token);
+    nav_repeat_keycode = keycode;
+    nav_repeat_down = true;
+    nav_repeat_interval = NAV_REPEAT_INTERVAL;
+    nav_repeat_token = defer_exec(NAV_REPEAT_DELAY, nav_repeat, NULL);
+
+  } else if (keycode == nav_repeat_keycode) {
+
+    cancel_deferred_exec(nav_repeat_token);
+    nav_repeat_token = INVALID_DEFERRED_TOKEN;
+    nav_repeat_keycode = KC_NO;
+
+  }
+
+}
+
+// Move an axis by its speed and keep the remaining fraction for the next
+// report. The axis does not move if neither or both directions are held.
+
+int8_t mouse_axis(uint8_t axis, uint16_t speed, uint8_t negative, uint8_t positive) {
+
+  uint8_t held = mouse_directions & (negative | positive);
+
+  if (held != negative && held != positive)
+    return 0;
+
+  uint16_t distance = mouse_fractions[axis] + speed;
+
+  mouse_fractions[axis] = distance & 0xFF;
+  distance >>= 8;
+
+  if (distance > 127)
+    distance = 127;
+
+  return held == positive ? distance : -distance;
+}
+
+// Send a mouse report for the held directions, keeping the buttons held by the
+// QMK mouse keys, and keep going until no direction is held.
 
+uint32_t mouse_move(uint32_t trigger_time, void *cb_arg) {
+
+  if (! mouse_directions) {
+    mouse_token = INVALID_DEFERRED_TOKEN;
+    return 0;
+  }
+
+  uint8_t mouse_index = MIN(timer_elapsed(mouse_timer) >> 3, MOUSE_CURVE_LENGTH - 1);
+  uint8_t wheel_index = MIN(timer_elapsed(wheel_timer) >> 3, MOUSE_CURVE_LENGTH - 1);
+  uint16_t mouse_speed = pgm_read_word(&mouse_speed_curve[mouse_index]);
+  uint16_t wheel_speed = pgm_read_word(&wheel_speed_curve[wheel_index]);
+
+  report_mouse_t report = mousekey_get_report();
+
+  report.x = mouse_axis(AXIS_X, mouse_speed, MOUSE_LEFT, MOUSE_RIGHT);
+  report.y = mouse_axis(AXIS_Y, mouse_speed, MOUSE_UP, MOUSE_DOWN);
+  report.v = mouse_axis(AXIS_V, wheel_speed, WHEEL_DOWN, WHEEL_UP);
+  report.h = mouse_axis(AXIS_H, wheel_speed, WHEEL_LEFT, WHEEL_RIGHT);
+
+  if (report.x || report.y || report.v || report.h)
+    host_mouse_send(&report);
+
+  return MOUSE_INTERVAL;
+}
+
+// Track the held mouse directions and start moving. The first report for a
+// newly held axis always moves by one pixel or wheel step.
+
+bool process_mouse_key(uint16_t keycode, keyrecord_t *record) {
+
+  uint8_t direction = 0;
+  uint8_t axis = 0;
+
+  switch (keycode) {
+    case KC_MS_LEFT:
+      direction = MOUSE_LEFT;
+      axis = AXIS_X;
+      break;
+    case KC_MS_RIGHT:
+      direction = MOUSE_RIGHT;
+      axis = AXIS_X;
+      break;
+    case KC_MS_UP:
+      direction = MOUSE_UP;
+      axis = AXIS_Y;
+      break;
+    case KC_MS_DOWN:
+      direction = MOUSE_DOWN;
+      axis = AXIS_Y;
+      break;
+    case KC_MS_WH_LEFT:
+      direction = WHEEL_LEFT;
+      axis = AXIS_H;
+      break;
+    case KC_MS_WH_RIGHT:
+      direction = WHEEL_RIGHT;
+      axis = AXIS_H;
+      break;
+    case KC_MS_WH_UP:
+      direction = WHEEL_UP;
+      axis = AXIS_V;
+      break;
+    case KC_MS_WH_DOWN:
+      direction = WHEEL_DOWN;
+      axis = AXIS_V;
+      break;
+  }
+
+  if (! record->event.pressed) {
+    mouse_directions &= ~direction;
+    return false;
   }
 
+  if (! (mouse_directions & MOUSE_POINTER) && (direction & MOUSE_POINTER))
+    mouse_timer = timer_read();
+
+  if (! (mouse_directions & MOUSE_WHEEL) && (direction & MOUSE_WHEEL))
+    wheel_timer = timer_read();
+
+  mouse_fractions[axis] = 0xFF;
+  mouse_directions |= direction;
+
+  if (mouse_token == INVALID_DEFERRED_TOKEN) {
+    mouse_move(0, NULL);
+    mouse_token = defer_exec(MOUSE_INTERVAL, mouse_move, NULL);
+  }
+
+  return false;
+}
+
+bool report_has_key(report_keyboard_t *report, uint8_t key) {
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (report->keys[i] == key)
+      return true;
+  }
+  return false;
+}
+
+// Record the differences between a report and the last report. Releases come
+// first and presses last, so that modifiers are held around the keys they
+// modify when the macro is played. While recording, the events are only added
+// if they leave room to release everything afterwards, and recording stops
+// once they do not.
+
+void macro_record_report(report_keyboard_t *report) {
+
+  uint8_t events[KEYBOARD_REPORT_KEYS * 2 + 8];
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    uint8_t key = macro_last_report.keys[i];
+    if (key && key < MACRO_MODS && ! report_has_key(report, key))
+      events[count++] = key;
+  }
+
+  for (uint8_t i = 0; i < 8; i++) {
+    uint8_t mod_bit = 1 << i;
+    if ((report->mods ^ macro_last_report.mods) & mod_bit)
+      events[count++] = (MACRO_MODS + i) | (report->mods & mod_bit ? MACRO_PRESSED : 0);
+  }
+
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    uint8_t key = report->keys[i];
+    if (key && key < MACRO_MODS && ! report_has_key(&macro_last_report, key))
+      events[count++] = key | MACRO_PRESSED;
+  }
+
+  if (macro_recording && recorded_macro->length + count > MACRO_SIZE - MACRO_RELEASE_RESERVE) {
+    dprintf("macro full after %u events, recording stopped\n", recorded_macro->length);
+    macro_overflowed = true;
+    macro_stop_recording();
+    return;
+  }
+
+  memcpy(&recorded_macro->events[recorded_macro->length], events, count);
+  recorded_macro->length += count;
+  macro_last_report = *report;
+
+}
+
+// Send keyboard reports through to the original host driver, recording the
+// keys that changed if a macro is being recorded.
+
+void hbm_send_keyboard(report_keyboard_t *report) {
+
+  if (macro_recording)
+    macro_record_report(report);
+
+  hbm_original_driver->send_keyboard(report);
+
+}
+
+void hbm_driver_install(void) {
+
+  if (host_get_driver() == &hbm_driver)
+    return;
+
+  hbm_original_driver = host_get_driver();
+  hbm_driver = *hbm_original_driver;
+  hbm_driver.send_keyboard = hbm_send_keyboard;
+  host_set_driver(&hbm_driver);
+
+}
+
+// Stop recording the macro. Keys still held when recording stops are released
+// at the end of the macro so that playing it never leaves keys held.
+
+void macro_stop_recording(void) {
+
+  macro_recording = false;
+
+  report_keyboard_t released = { 0 };
+  macro_record_report(&released);
+
+#ifdef MACRO_PERSIST
+  macro_save();
+#endif
+
+}
+
+#ifdef MACRO_PERSIST
+
+// Store the macro in EEPROM. QMK can only write the whole datablock, so the
+// stored settings are read back and written with the macro, so that settings
+// changed over raw HID but not saved are not saved along with it.
+
+void macro_save(void) {
+
+  hbm_config_t stored;
+
+  eeconfig_read_user_datablock(&stored);
+  stored.macro = *recorded_macro;
+  eeconfig_update_user_datablock(&stored);
+
+}
+
+#endif
+
+// Start or stop recording the macro. If recording already stopped because the
+// macro was full, the next press is ignored unless the macro has been played
+// since, so that the press meant to stop recording does not start a new
+// recording over the full macro.
+
+void macro_toggle_recording(void) {
+
+  if (macro_playing)
+    return;
+
+  if (macro_overflowed) {
+    macro_overflowed = false;
+    return;
+  }
+
+  if (macro_recording) {
+    macro_stop_recording();
+    return;
+  }
+
+  hbm_driver_install();
+  recorded_macro->length = 0;
+  macro_last_report = *keyboard_report;
+  macro_recording = true;
+
+}
+
+// Play the macro one event at a time at the fastest rate the selected
+// operating system allows.
+
+uint32_t macro_play_event(uint32_t trigger_time, void *cb_arg) {
+
+  if (macro_position >= recorded_macro->length) {
+    macro_playing = false;
+    return 0;
+  }
+
+  uint8_t event = recorded_macro->events[macro_position++];
+  uint8_t keycode = event & ~MACRO_PRESSED;
+
+  if (keycode >= MACRO_MODS)
+    keycode = KC_LCTL + keycode - MACRO_MODS;
+
+  if (event & MACRO_PRESSED)
+    register_code(keycode);
+  else
+    unregister_code(keycode);
+
+  return pgm_read_byte(&macro_play_intervals[selected_operating_system]);
+}
+
+void macro_play(void) {
+
+  if (macro_recording || macro_playing || ! recorded_macro->length)
+    return;
+
+  macro_overflowed = false;
+  macro_position = 0;
+  macro_playing = true;
+  defer_exec(1, macro_play_event, NULL);
+
+}
+
+// Find the matrix positions of the combo keys on the base layer.
+
+void combo_init(void) {
+
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+
+      uint16_t keycode = keymap_key_to_keycode(LAYER_BASE, (keypos_t){ .row = row, .col = col });
+
+      if (keycode == KC_NO)
+        continue;
+
+      for (uint8_t i = 0; i < COMBO_COUNT; i++) {
+        for (uint8_t k = 0; k < COMBO_MAX_KEYS; k++) {
+          if (keycode == pgm_read_word(&hbm_combos[i].keys[k]))
+            combo_masks[i] |= (combo_mask_t)1 << (row * MATRIX_COLS + col);
+        }
+      }
+
+    }
+  }
+
+  for (uint8_t i = 0; i < COMBO_COUNT; i++)
+    combo_keys |= combo_masks[i];
+
+}
+
+// Process the held back keypresses in the order they were pressed, as though
+// they had not been held back. Each is given the weak modifiers it had when it
+// was pressed, since caps word has already seen it.
+
+void combo_flush(void) {
+
+  uint8_t length = combo_buffer_length;
+  uint8_t weak_mods = get_weak_mods();
+
+  cancel_deferred_exec(combo_token);
+  combo_token = INVALID_DEFERRED_TOKEN;
+  combo_buffer_length = 0;
+  combo_pressed = 0;
+  combo_flushing = true;
+
+  for (uint8_t i = 0; i < length; i++) {
+    combo_press_t *press = &combo_buffer[i];
+    set_weak_mods(press->weak_mods);
+    if (process_record_user(press->keycode, &press->record))
+      register_code(press->keycode);
+  }
+
+  combo_flushing = false;
+  set_weak_mods(weak_mods);
+
+}
+
+uint32_t combo_timeout(uint32_t trigger_time, void *cb_arg) {
+  combo_token = INVALID_DEFERRED_TOKEN;
+  combo_flush();
+  return 0;
+}
+
+// Hold back keypresses on combo keys until they form a combo, cannot form a
+// combo, are released, or the combo term passes. Keys that are not part of a
+// combo are never held back, but let any held back keys go first so that
+// keypresses are always processed in order. This runs after the tapping code,
+// so a combo is never sent ahead of a tap-hold key pressed before it. Combos
+// are ignored while modifiers are held so that homerow modifiers and the
+// opposite hand rule work as usual. Return false if the keypress has been held
+// back or formed a combo.
+
+bool process_combos(uint16_t keycode, keyrecord_t *record) {
+
+  keypos_t key = record->event.key;
+
+  if (combo_flushing || key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS)
+    return true;
+
+  combo_mask_t key_bit = (combo_mask_t)1 << (key.row * MATRIX_COLS + key.col);
+
+  // Keypresses that the tapping code held back can arrive after the combo term
+  // but before the combo timeout has run.
+
+  if (combo_buffer_length && TIMER_DIFF_16(record->event.time, combo_buffer[0].record.event.time) >= COMBO_TERM)
+    combo_flush();
+
+  // Drop releases of keys that formed a combo.
+
+  if (! record->event.pressed) {
+    if (combo_consumed & key_bit) {
+      combo_consumed &= ~key_bit;
+      return false;
+    }
+    if (combo_buffer_length)
+      combo_flush();
+    return true;
+  }
+
+  if (! (combo_keys & key_bit) || get_mods() || get_highest_layer(layer_state) != LAYER_BASE) {
+    if (combo_buffer_length)
+      combo_flush();
+    return true;
+  }
+
+  // Hold the key back. A combo is possible while the held back keys are all
+  // keys of the combo, and matches once they are all of its keys. If no combo
+  // is possible with this key, the keys already held back are let go first.
+
+  combo_mask_t pressed = combo_pressed | key_bit;
+  bool possible = false;
+
+  for (uint8_t i = 0; i < COMBO_COUNT && ! possible; i++)
+    possible = (combo_masks[i] & pressed) == pressed;
+
+  if (! possible || combo_buffer_length == COMBO_MAX_KEYS)
+    combo_flush();
+
+  combo_buffer[combo_buffer_length++] = (combo_press_t){ *record, keycode, get_weak_mods() };
+  combo_pressed |= key_bit;
+
+  // Symbols are sent unshifted, as they are on the symbol layers, whatever
+  // caps word or a oneshot shift would have done to the keys.
+
+  for (uint8_t i = 0; i < COMBO_COUNT; i++) {
+    if (combo_masks[i] == combo_pressed) {
+      cancel_deferred_exec(combo_token);
+      combo_token = INVALID_DEFERRED_TOKEN;
+      combo_consumed |= combo_pressed;
+      combo_pressed = 0;
+      combo_buffer_length = 0;
+      del_weak_mods(MOD_MASK_SHIFT);
+      del_oneshot_mods(MOD_MASK_SHIFT);
+      tap_code16(pgm_read_word(&hbm_combos[i].output));
+      return false;
+    }
+  }
+
+  if (combo_token == INVALID_DEFERRED_TOKEN)
+    combo_token = defer_exec(COMBO_TERM, combo_timeout, NULL);
+
+  return false;
+}
+
+// Send a custom keycode as though it had been tapped, so that the actions for
+// the selected operating system are used.
+
+void leader_send(uint16_t keycode) {
+
+  keyrecord_t record = { .event = { .pressed = true } };
+
+  leader_sending = true;
+  process_record_user(keycode, &record);
+  record.event.pressed = false;
+  process_record_user(keycode, &record);
+  leader_sending = false;
+
+}
+
+// Finish the leader sequence, sending the action for the current node if there
+// is one.
+
+void leader_end(bool send) {
+
+  uint16_t action = KC_NO;
+
+  if (send)
+    action = pgm_read_word(&leader_trie[leader_node].action);
+
+  cancel_deferred_exec(leader_token);
+  leader_token = INVALID_DEFERRED_TOKEN;
+  leader_node = LN_INACTIVE;
+
+  if (action != KC_NO)
+    leader_send(action);
+
+}
+
+uint32_t leader_timeout(uint32_t trigger_time, void *cb_arg) {
+  leader_token = INVALID_DEFERRED_TOKEN;
+  leader_end(true);
+  return 0;
+}
+
+void leader_start(void) {
+  cancel_deferred_exec(leader_token);
+  leader_node = LN_ROOT;
+  leader_token = defer_exec(LEADER_TIMEOUT, leader_timeout, NULL);
+}
+
+// Follow the leader trie for each alpha keypress and return false if the
+// keypress has been consumed. Any other keypress cancels the sequence.
+
+bool process_leader(uint16_t keycode, keyrecord_t *record) {
+
+  keypos_t key = record->event.key;
+  matrix_row_t col_bit = (matrix_row_t)1 << key.col;
+
+  // Releases of consumed keypresses are dropped, since nothing was registered
+  // for them. Other releases are processed as usual so that no key is left
+  // registered.
+
+  if (! record->event.pressed) {
+    if (key.row < MATRIX_ROWS && (leader_consumed[key.row] & col_bit)) {
+      leader_consumed[key.row] &= ~col_bit;
+      return false;
+    }
+    return true;
+  }
+
+  if (leader_node == LN_INACTIVE)
+    return true;
+
+  // Held layer and homerow modifier keys are processed as usual, otherwise use
+  // the tapped keycode.
+
+  if (IS_QK_MOD_TAP(keycode) || IS_QK_LAYER_TAP(keycode)) {
+    if (! record->tap.count)
+      return true;
+    keycode = keycode & 0xFF;
+  }
+
+  if (keycode < KC_A || keycode > KC_Z) {
+    leader_end(false);
+    return true;
+  }
+
+  uint8_t child = pgm_read_byte(&leader_trie[leader_node].children[keycode - KC_A]);
+
+  if (child == LN_ROOT) {
+    leader_end(false);
+  } else {
+    leader_node = child;
+    if (pgm_read_byte(&leader_trie[leader_node].leaf))
+      leader_end(true);
+    else
+      extend_deferred_exec(leader_token, LEADER_TIMEOUT);
+  }
+
+  if (key.row < MATRIX_ROWS)
+    leader_consumed[key.row] |= col_bit;
+
   return false;
 }
 
@@ -393,6 +1530,23 @@ bool process_record_user_windows(uint16_t keycode, keyrecord_t *record) {
       }
       break;
 
+    // Window actions carried out by the shortcuts.ahk script.
+
+    case M_APP_1 ... M_APP_5:
+      if (record->event.pressed)
+        tap_code16(HYPR(KC_1 + keycode - M_APP_1));
+      break;
+
+    case M_MAXIMISE:
+      if (record->event.pressed)
+        tap_code16(HYPR(KC_J));
+      break;
+
+    case M_CLOSE:
+      if (record->event.pressed)
+        tap_code16(HYPR(KC_K));
+      break;
+
     // Open the emoji window.
 
     case M_EMOJI:
@@ -456,6 +1610,23 @@ bool process_record_user_chromeos(uint16_t keycode, keyrecord_t *record) {
       }
       break;
 
+    // Open the apps pinned to the shelf, maximise and close the window.
+
+    case M_APP_1 ... M_APP_5:
+      if (record->event.pressed)
+        tap_code16(LALT(KC_1 + keycode - M_APP_1));
+      break;
+
+    case M_MAXIMISE:
+      if (record->event.pressed)
+        tap_code16(LALT(KC_EQL));
+      break;
+
+    case M_CLOSE:
+      if (record->event.pressed)
+        tap_code16(LCTL(LSFT(KC_W)));
+      break;
+
     // Open the emoji window.
 
     case M_EMOJI:
@@ -502,16 +1673,41 @@ bool process_record_user_linux(uint16_t keycode, keyrecord_t *record) {
         SEND_STRING(SS_UP(X_LALT)SS_UP(X_LCTL));
       }
       break;
+
+    // Window actions carried out by the companion daemon.
+
+    case M_APP_1 ... M_APP_5:
+      if (record->event.pressed)
+        send_action(ACTION_APP_1 + keycode - M_APP_1);
+      break;
+
+    case M_MINIMISE:
+      if (record->event.pressed)
+        send_action(ACTION_MINIMISE);
+      break;
+
+    case M_MAXIMISE:
+      if (record->event.pressed)
+        send_action(ACTION_MAXIMISE);
+      break;
+
+    case M_CLOSE:
+      if (record->event.pressed)
+        send_action(ACTION_CLOSE);
+      break;
   }
 
   return true;
 }
 
-// Only capitalise alpha characters and remove the minus character so that
-// typing '-' stops the caps word.
+// Only capitalise alpha characters in SHOUTING_CASE, or the first alpha after a
+// space in camelCase. Remove the minus character so that typing '-' stops caps
+// word unless it is being used to join words.
 
 bool caps_word_press_user(uint16_t keycode) {
 
+  caps_word_timer = timer_read();
+
   switch (keycode) {
 
     // Basic alpha keycodes continue caps word with shift applied.
@@ -542,9 +1738,19 @@ bool caps_word_press_user(uint16_t keycode) {
     case KC_O:
     case KC_K:
     case KC_H:
-      add_weak_mods(MOD_BIT(KC_LSFT));
+      if (caps_word_modes[caps_word_mode].shift_alphas || caps_word_shift_next)
+        add_weak_mods(MOD_BIT(KC_LSFT));
+      caps_word_shift_next = false;
       return true;
 
+    // Space continues caps word if the current mode joins words with it.
+
+    case KC_SPC:
+      return caps_word_modes[caps_word_mode].space != KC_SPC;
+
+    case KC_MINS:
+      return caps_word_modes[caps_word_mode].space == KC_MINS;
+
     // Number keys, underscore, backspace and del continue caps word but are not
     // shifted themselves.
 
@@ -576,6 +1782,29 @@ bool caps_word_press_user(uint16_t keycode) {
   }
 }
 
+// Restart the caps word idle timeout when caps word is turned on, and go back
+// to SHOUTING_CASE when it is turned off.
+
+void caps_word_set_user(bool active) {
+  if (active) {
+    caps_word_timer = timer_read();
+  } else {
+    caps_word_mode = CW_SHOUTING_CASE;
+    caps_word_shift_next = false;
+  }
+}
+
+// Turn off caps word once it has been idle for the caps word idle timeout.
+
+void housekeeping_task_user(void) {
+
+  uint16_t idle_timeout = hbm_config.settings[SETTING_CAPS_WORD_IDLE_TIMEOUT];
+
+  if (idle_timeout && is_caps_word_on() && timer_elapsed(caps_word_timer) > idle_timeout)
+    caps_word_off();
+
+}
+
 // Set the tapping terms for layer and tap dance keys.
 
 uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record) {
@@ -584,46 +1813,267 @@ uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record) {
     case LT_NAV:
     case LT_FUNC:
     case LT_CTLS:
-      return TAPPING_TERM_LAYER;
+      return hbm_config.settings[SETTING_TAPPING_TERM_LAYER];
     case HR_LCA:
     case HR_LALT:
     case HR_LCTL:
     case HR_RCTL:
     case HR_RALT:
     case HR_RCA:
-      return TAPPING_TERM_HOMEROW;
+      return hbm_config.settings[SETTING_TAPPING_TERM_HOMEROW];
     case HR_LGUI:
     case HR_RGUI:
-      return TAPPING_TERM_HOMEROW_GUI;
+      return hbm_config.settings[SETTING_TAPPING_TERM_HOMEROW_GUI];
     default:
       return TAPPING_TERM;
   }
 }
 
+// Tap-hold keys that cannot be tuned always get permissive hold.
+
 bool get_permissive_hold(uint16_t keycode, keyrecord_t *record) {
+
+  uint16_t key_bit = tunable_key_bit(keycode);
+
+  if (! key_bit)
+    return true;
+
+  return hbm_config.settings[SETTING_PERMISSIVE_HOLD_KEYS] & key_bit;
+}
+
+bool get_retro_tapping(uint16_t keycode, keyrecord_t *record) {
+  return hbm_config.settings[SETTING_RETRO_TAPPING_KEYS] & tunable_key_bit(keycode);
+}
+
+// Return the bit for a tap-hold key in the permissive hold and retro tapping
+// settings.
+
+uint16_t tunable_key_bit(uint16_t keycode) {
   switch (keycode) {
+    case LT_LSYM:
+      return TK_BIT(TK_LT_LSYM);
+    case LT_RSYM:
+      return TK_BIT(TK_LT_RSYM);
+    case LT_NAV:
+      return TK_BIT(TK_LT_NAV);
+    case LT_NUM:
+      return TK_BIT(TK_LT_NUM);
+    case LT_FUNC:
+      return TK_BIT(TK_LT_FUNC);
+    case LT_CTLS:
+      return TK_BIT(TK_LT_CTLS);
     case HR_LGUI:
+      return TK_BIT(TK_HR_LGUI);
     case HR_LALT:
+      return TK_BIT(TK_HR_LALT);
+    case HR_LCTL:
+      return TK_BIT(TK_HR_LCTL);
+    case HR_LCA:
+      return TK_BIT(TK_HR_LCA);
+    case HR_RCA:
+      return TK_BIT(TK_HR_RCA);
+    case HR_RCTL:
+      return TK_BIT(TK_HR_RCTL);
     case HR_RALT:
+      return TK_BIT(TK_HR_RALT);
     case HR_RGUI:
-      return false;
+      return TK_BIT(TK_HR_RGUI);
     default:
-      return true;
+      return 0;
   }
 }
 
-// Only the space, enter, alt and gui keys get retro tapping.
+// Reset the runtime settings to their defaults and store them in EEPROM.
+
+void eeconfig_init_user(void) {
+
+  hbm_config.version = HBM_CONFIG_VERSION;
+
+  for (uint8_t i = 0; i < SETTING_COUNT; i++)
+    hbm_config.settings[i] = pgm_read_word(&hbm_default_settings[i]);
+
+#ifdef MACRO_PERSIST
+  recorded_macro->length = 0;
+#endif
+
+  eeconfig_update_user_datablock(&hbm_config);
+
+}
+
+// Read the runtime settings from EEPROM, resetting them if they were stored by
+// an incompatible version of the firmware, and set up the combos.
+
+void keyboard_post_init_user(void) {
+
+  eeconfig_read_user_datablock(&hbm_config);
+
+  if (hbm_config.version != HBM_CONFIG_VERSION)
+    eeconfig_init_user();
+
+#ifdef MACRO_PERSIST
+  if (recorded_macro->length > MACRO_SIZE)
+    recorded_macro->length = 0;
+#endif
+
+  combo_init();
+
+}
+
+// Ask the companion daemon on the host to carry out a window action.
+
+void send_action(uint8_t action) {
+
+  uint8_t data[HID_REPORT_SIZE] = { HID_ACTION, action };
+
+  raw_hid_send(data, sizeof(data));
+
+}
+
+// Get and set the runtime settings over raw HID. Settings take effect as soon
+// as they are set and are only written to EEPROM when saved.
+
+void raw_hid_receive(uint8_t *data, uint8_t length) {
+
+  uint8_t setting = data[1];
+  uint8_t status = HID_STATUS_OK;
+
+  switch (data[0]) {
+
+    case HID_GET_VERSION:
+      data[1] = SETTING_COUNT;
+      data[2] = HBM_CONFIG_VERSION;
+      data[3] = 0;
+      break;
+
+    case HID_GET_SETTING:
+      if (setting < SETTING_COUNT) {
+        data[2] = hbm_config.settings[setting] & 0xFF;
+        data[3] = hbm_config.settings[setting] >> 8;
+      } else {
+        status = HID_STATUS_ERROR;
+      }
+      break;
+
+    case HID_SET_SETTING:
+      if (setting < SETTING_COUNT) {
+        uint16_t value = data[2] | (data[3] << 8);
+        if (value >= pgm_read_word(&hbm_setting_ranges[setting].min) &&
+            value <= pgm_read_word(&hbm_setting_ranges[setting].max))
+          hbm_config.settings[setting] = value;
+        else
+          status = HID_STATUS_ERROR;
+      } else {
+        status = HID_STATUS_ERROR;
+      }
+      break;
+
+    case HID_SAVE_SETTINGS:
+      eeconfig_update_user_datablock(&hbm_config);
+      break;
+
+    case HID_RESET_SETTINGS:
+      eeconfig_init_user();
+      break;
 
-bool get_retro_tapping(uint16_t keycode, keyrecord_t *record) {
-  switch (keycode) {
-    case LT_NUM:
-    case LT_NAV:
-    case HR_LGUI:
-    case HR_LALT:
-    case HR_RALT:
-    case HR_RGUI:
-      return true;
     default:
-      return false;
+      status = HID_STATUS_ERROR;
+
   }
+
+  data[4] = status;
+  raw_hid_send(data, length);
+
+}
+
+// Per-key debounce state. Each key has a countdown in milliseconds and a flag
+// that records whether the countdown is locking out bounces after a press or
+// deferring a release.
+
+typedef struct {
+  bool pressed : 1;
+  uint8_t time : 7;
+} debounce_counter_t;
+
+static debounce_counter_t debounce_counters[MATRIX_ROWS * MATRIX_COLS];
+static fast_timer_t debounce_timer;
+static bool debounce_counting = false;
+
+// On split keyboards each half only debounces its own rows, so keep track of
+// where this half's rows start in the debounce_times table.
+
+static uint8_t debounce_row_offset = 0;
+
+void debounce_init(uint8_t num_rows) {
+
+  memset(debounce_counters, 0, sizeof(debounce_counters));
+  debounce_timer = timer_read_fast();
+
+#ifdef SPLIT_KEYBOARD
+  if (! is_keyboard_left())
+    debounce_row_offset = num_rows;
+#endif
+
+}
+
+// Report presses immediately and then ignore the key until its debounce time
+// has passed. Report releases only once the key has stayed released for its
+// debounce time.
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed) {
+
+  bool cooked_changed = false;
+  fast_timer_t elapsed = timer_elapsed_fast(debounce_timer);
+
+  debounce_timer = timer_read_fast();
+
+  if (! changed && ! debounce_counting)
+    return false;
+
+  debounce_counting = false;
+
+  for (uint8_t row = 0; row < num_rows; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+
+      debounce_counter_t *counter = &debounce_counters[row * MATRIX_COLS + col];
+      matrix_row_t col_mask = MATRIX_ROW_SHIFTER << col;
+
+      // Count down and accept a deferred release once its time has passed.
+
+      if (counter->time) {
+        if (counter->time <= elapsed) {
+          counter->time = 0;
+          if (! counter->pressed && ! (raw[row] & col_mask) && (cooked[row] & col_mask)) {
+            cooked[row] &= ~col_mask;
+            cooked_changed = true;
+          }
+        } else {
+          counter->time -= elapsed;
+        }
+      }
+
+      // Start a new countdown when the key changes state.
+
+      if ((raw[row] ^ cooked[row]) & col_mask) {
+        if (! counter->time) {
+          counter->pressed = raw[row] & col_mask;
+          counter->time = pgm_read_byte(&debounce_times[row + debounce_row_offset][col]) & 0x7F;
+          if (counter->pressed || ! counter->time) {
+            cooked[row] ^= col_mask;
+            cooked_changed = true;
+          }
+        }
+      } else if (counter->time && ! counter->pressed) {
+
+        // The key bounced back down before its release was accepted.
+
+        counter->time = 0;
+      }
+
+      if (counter->time)
+        debounce_counting = true;
+
+    }
+  }
+
+  return cooked_changed;
 }
@@ -51,11 +51,97 @@ enum hbm_keycodes {
   M_FULLSCREEN,
   M_MINIMISE,
   M_EMOJI,
+  M_LEADER,
+  M_MACRO_REC,
+  M_MACRO_PLAY,
+  M_APP_1,
+  M_APP_2,
+  M_APP_3,
+  M_APP_4,
+  M_APP_5,
+  M_MAXIMISE,
+  M_CLOSE,
   M_ISWINDOWS,
   M_ISCHROMEOS,
   M_ISLINUX
 };
 
+// Settings that can be changed at runtime over raw HID. The values are stored
+// in EEPROM, along with the macro if it is persisted, and neither the order of
+// the settings nor the layout of the macro may change without bumping
+// HBM_CONFIG_VERSION.
+
+#define HBM_CONFIG_VERSION 2
+
+enum hbm_settings {
+  SETTING_TAPPING_TERM_LAYER,
+  SETTING_TAPPING_TERM_HOMEROW,
+  SETTING_TAPPING_TERM_HOMEROW_GUI,
+  SETTING_CAPS_WORD_IDLE_TIMEOUT,
+  SETTING_PERMISSIVE_HOLD_KEYS,
+  SETTING_RETRO_TAPPING_KEYS,
+  SETTING_COUNT
+};
+
+// Tap-hold keys that can be added to or removed from the permissive hold and
+// retro tapping settings. Each key is one bit in those settings.
+
+enum hbm_tunable_keys {
+  TK_LT_LSYM,
+  TK_LT_RSYM,
+  TK_LT_NAV,
+  TK_LT_NUM,
+  TK_LT_FUNC,
+  TK_LT_CTLS,
+  TK_HR_LGUI,
+  TK_HR_LALT,
+  TK_HR_LCTL,
+  TK_HR_LCA,
+  TK_HR_RCA,
+  TK_HR_RCTL,
+  TK_HR_RALT,
+  TK_HR_RGUI,
+  TK_COUNT
+};
+
+// Raw HID commands. Requests and responses are laid out as the command, the
+// setting, the value as a little-endian 16 bit number, then a status byte.
+
+enum hbm_hid_commands {
+  HID_GET_VERSION = 0x01,
+  HID_GET_SETTING,
+  HID_SET_SETTING,
+  HID_SAVE_SETTINGS,
+  HID_RESET_SETTINGS,
+  HID_ACTION = 0x10
+};
+
+enum hbm_hid_status {
+  HID_STATUS_OK,
+  HID_STATUS_ERROR
+};
+
+// Window actions carried out by the companion daemon on the host. The keyboard
+// sends HID_ACTION followed by the action in a single report.
+
+enum hbm_actions {
+  ACTION_APP_1,
+  ACTION_APP_2,
+  ACTION_APP_3,
+  ACTION_APP_4,
+  ACTION_APP_5,
+  ACTION_MINIMISE,
+  ACTION_MAXIMISE,
+  ACTION_CLOSE
+};
+
+#define HID_REPORT_SIZE 32
+
+// Per-key debounce times, defined in each keyboard's keymap.c using the
+// LAYOUT_DEBOUNCE macro.
+
+extern const uint8_t PROGMEM debounce_times[MATRIX_ROWS][MATRIX_COLS];
+
 // Alternative keys for UK ISO keyboard layouts.
 
 #define UK_DQUO LSFT(KC_2)
@@ -180,8 +266,8 @@ enum hbm_keycodes {
 #define KM_NUM_2L KC_NO, KC_4, KC_5, KC_6, KC_DOT
 #define KM_NUM_3L KC_NO, KC_7, KC_8, KC_9, KC_0
 
-#define KM_NUM_1R KC_MS_BTN2, KC_NO, KC_NO, KC_NO, KC_NO
-#define KM_NUM_2R KC_MS_BTN1, KC_NO, KC_NO, KC_NO, KC_NO
+#define KM_NUM_1R KC_MS_BTN2, M_APP_1, M_APP_2, M_APP_3, M_APP_4
+#define KM_NUM_2R KC_MS_BTN1, M_APP_5, M_MAXIMISE, M_CLOSE, KC_NO
 #define KM_NUM_3R KC_RCA, KC_RCTL, KC_RALT, KC_RGUI, KC_NO
 
 #define KM_NUM_1 KM_NUM_1L, KM_NUM_1R
@@ -194,8 +280,8 @@ enum hbm_keycodes {
 
 // Navigation layer.
 
-#define KM_NAV_1L KC_NO, KC_NO, KC_NO, KC_NO, KC_MS_BTN2
-#define KM_NAV_2L KC_NO, KC_NO, KC_NO, KC_NO, KC_MS_BTN1
+#define KM_NAV_1L KC_MS_WH_LEFT, KC_MS_WH_DOWN, KC_MS_WH_UP, KC_MS_WH_RIGHT, KC_MS_BTN2
+#define KM_NAV_2L KC_MS_LEFT, KC_MS_DOWN, KC_MS_UP, KC_MS_RIGHT, KC_MS_BTN1
 #define KM_NAV_3L KC_NO, KC_LGUI, KC_LALT, KC_LCTL, KC_LCA
 
 #define KM_NAV_1R M_OVERVIEW, M_PDESK, KC_CTL_TAB, M_ALT_TAB, M_NDESK
@@ -230,9 +316,9 @@ enum hbm_keycodes {
 
 // Controls layer.
 
-#define KM_CTLS_1L KC_NO, KC_MPLY, KC_MUTE, KC_PSCR, M_ISWINDOWS
-#define KM_CTLS_2L KC_NO, KC_MNXT, KC_VOLU, KC_BRIU, M_ISCHROMEOS
-#define KM_CTLS_3L KC_NO, KC_MPRV, KC_VOLD, KC_BRID, M_ISLINUX
+#define KM_CTLS_1L M_LEADER, KC_MPLY, KC_MUTE, KC_PSCR, M_ISWINDOWS
+#define KM_CTLS_2L M_MACRO_REC, KC_MNXT, KC_VOLU, KC_BRIU, M_ISCHROMEOS
+#define KM_CTLS_3L M_MACRO_PLAY, KC_MPRV, KC_VOLD, KC_BRID, M_ISLINUX
 
 #define KM_CTLS_1R KC_NO, KC_NO, KC_TRNS, KC_NO, KC_NO
 #define KM_CTLS_2R KC_NO, KC_NO, KC_NO, KC_NO, KC_NO
@@ -27,3 +27,6 @@ const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
   [LAYER_FUNC] = HBM_LAYOUT_ferris_sweep( LAYOUT_FUNC ),
   [LAYER_CTLS] = HBM_LAYOUT_ferris_sweep( LAYOUT_CTLS )
 };
+
+const uint8_t PROGMEM debounce_times[MATRIX_ROWS][MATRIX_COLS] =
+  HBM_LAYOUT_ferris_sweep( LAYOUT_DEBOUNCE );
@@ -7,3 +7,9 @@ INTROSPECTION_KEYMAP_C += hbmorrison.c
 SEND_STRING_ENABLE = yes
 CAPS_WORD_ENABLE = yes
 MOUSEKEY_ENABLE = yes
+DEFERRED_EXEC_ENABLE = yes
+RAW_ENABLE = yes
+
+# Per-key eager press and deferred release debouncing.
+
+DEBOUNCE_TYPE = custom
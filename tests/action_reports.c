@@ -0,0 +1,51 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Print the raw HID reports sent on Linux by the app, minimise, maximise and
+// close keys, in that order, for testing hbm_actions.py. Each report is
+// printed as one line of hex.
+
+#include "harness.h"
+
+static void print_report(uint8_t *data, uint8_t length) {
+  for (uint8_t i = 0; i < length; i++)
+    printf("%02x", data[i]);
+  printf("\n");
+}
+
+// Tap a key on the given layer, holding the layer key for it.
+
+static void tap_layer(uint16_t layer_keycode, uint8_t layer, uint16_t keycode) {
+  keypos_t layer_key = harness_find(LAYER_BASE, layer_keycode);
+  harness_event(layer_key, true, 0);
+  harness_tap(harness_find(layer, keycode));
+  harness_event(layer_key, false, 0);
+}
+
+int main(void) {
+
+  harness_reset(OS_LINUX);
+  harness_raw_hid_send = print_report;
+
+  for (uint16_t keycode = M_APP_1; keycode <= M_APP_5; keycode++)
+    tap_layer(LT_NUM, LAYER_NUM, keycode);
+  tap_layer(LT_NAV, LAYER_NAV, M_MINIMISE);
+  tap_layer(LT_NUM, LAYER_NUM, M_MAXIMISE);
+  tap_layer(LT_NUM, LAYER_NUM, M_CLOSE);
+
+  return 0;
+}
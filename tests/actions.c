@@ -0,0 +1,105 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that the app, minimise, maximise and close keys send a raw HID action
+// to the companion daemon on Linux and a keyboard shortcut everywhere else.
+
+#include "harness.h"
+
+static uint8_t last_action;
+
+static void record_action(uint8_t *data, uint8_t length) {
+  if (data[0] == HID_ACTION)
+    last_action = data[1];
+}
+
+// Tap a key on the given layer, holding the layer key for it.
+
+static void tap_layer(uint16_t layer_keycode, uint8_t layer, uint16_t keycode) {
+  keypos_t layer_key = harness_find(LAYER_BASE, layer_keycode);
+  harness_event(layer_key, true, 0);
+  harness_clear_counts();
+  last_action = 0xFF;
+  harness_tap(harness_find(layer, keycode));
+  harness_event(layer_key, false, 0);
+}
+
+// Check that the key sent the action over raw HID and no keyboard reports.
+
+static void expect_action(uint16_t layer_keycode, uint8_t layer, uint16_t keycode, uint8_t action) {
+  tap_layer(layer_keycode, layer, keycode);
+  HARNESS_CHECK(harness_raw_hid_reports == 1 && last_action == action,
+    "key %04X sent %u raw HID reports with action %u", keycode, harness_raw_hid_reports, last_action);
+  HARNESS_CHECK(harness_keyboard_reports == 0, "key %04X sent %u keyboard reports", keycode,
+    harness_keyboard_reports);
+}
+
+// Check that the key pressed the given key with exactly the given mods and
+// sent nothing over raw HID.
+
+static void expect_shortcut(uint16_t layer_keycode, uint8_t layer, uint16_t keycode, uint8_t key,
+  uint8_t mods) {
+
+  tap_layer(layer_keycode, layer, keycode);
+  HARNESS_CHECK(harness_raw_hid_reports == 0, "key %04X sent a raw HID report", keycode);
+
+  const report_keyboard_t *sent = NULL;
+  for (uint32_t i = 0; i < harness_keyboard_reports && i < HARNESS_REPORT_LOG_SIZE && ! sent; i++) {
+    if (harness_report_has_key(&harness_reports[i], key))
+      sent = &harness_reports[i];
+  }
+  HARNESS_CHECK(sent, "key %04X did not press %02X", keycode, key);
+  HARNESS_CHECK(sent->mods == mods, "key %04X sent mods %02X instead of %02X", keycode, sent->mods,
+    mods);
+  HARNESS_CHECK(harness_last_report.mods == 0 && ! harness_last_report.keys[0],
+    "key %04X left keys held", keycode);
+}
+
+int main(void) {
+
+  const uint8_t hyper = MOD_BIT(KC_LSFT) | MOD_BIT(KC_LCTL) | MOD_BIT(KC_LALT) | MOD_BIT(KC_LGUI);
+  const uint8_t alt = MOD_BIT(KC_LALT);
+
+  harness_reset(OS_LINUX);
+  harness_raw_hid_send = record_action;
+  for (uint16_t keycode = M_APP_1; keycode <= M_APP_5; keycode++)
+    expect_action(LT_NUM, LAYER_NUM, keycode, ACTION_APP_1 + keycode - M_APP_1);
+  expect_action(LT_NAV, LAYER_NAV, M_MINIMISE, ACTION_MINIMISE);
+  expect_action(LT_NUM, LAYER_NUM, M_MAXIMISE, ACTION_MAXIMISE);
+  expect_action(LT_NUM, LAYER_NUM, M_CLOSE, ACTION_CLOSE);
+  printf("ok - linux window actions go to the daemon\n");
+
+  harness_reset(OS_WINDOWS);
+  harness_raw_hid_send = record_action;
+  for (uint16_t keycode = M_APP_1; keycode <= M_APP_5; keycode++)
+    expect_shortcut(LT_NUM, LAYER_NUM, keycode, KC_1 + keycode - M_APP_1, hyper);
+  expect_shortcut(LT_NAV, LAYER_NAV, M_MINIMISE, KC_DOWN, MOD_BIT(KC_LGUI));
+  expect_shortcut(LT_NUM, LAYER_NUM, M_MAXIMISE, KC_J, hyper);
+  expect_shortcut(LT_NUM, LAYER_NUM, M_CLOSE, KC_K, hyper);
+  printf("ok - windows window actions send the shortcuts.ahk chords and win-down\n");
+
+  harness_reset(OS_CHROMEOS);
+  harness_raw_hid_send = record_action;
+  for (uint16_t keycode = M_APP_1; keycode <= M_APP_5; keycode++)
+    expect_shortcut(LT_NUM, LAYER_NUM, keycode, KC_1 + keycode - M_APP_1, alt);
+  expect_shortcut(LT_NAV, LAYER_NAV, M_MINIMISE, KC_MINS, alt);
+  expect_shortcut(LT_NUM, LAYER_NUM, M_MAXIMISE, KC_EQL, alt);
+  expect_shortcut(LT_NUM, LAYER_NUM, M_CLOSE, KC_W, MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT));
+  printf("ok - chromeos window actions send chromeos shortcuts\n");
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that both shift keys act as oneshot shifts when tapped and pick the
+// caps word mode from the number of taps.
+
+#include "harness.h"
+
+// Tap a key the given number of times in quick succession, as the tapping
+// code delivers it with a rising tap count.
+
+static void tap_times(keypos_t key, uint8_t taps) {
+  for (uint8_t count = 1; count <= taps; count++) {
+    harness_event(key, true, count);
+    harness_event(key, false, count);
+  }
+}
+
+// Return the first report since the counts were cleared that has the key
+// pressed, or NULL if there is none.
+
+static const report_keyboard_t *find_report(uint8_t key) {
+  for (uint32_t i = 0; i < harness_keyboard_reports && i < HARNESS_REPORT_LOG_SIZE; i++) {
+    if (harness_report_has_key(&harness_reports[i], key))
+      return &harness_reports[i];
+  }
+  return NULL;
+}
+
+// Tap a key and return the report that had it pressed.
+
+static report_keyboard_t press(uint16_t keycode) {
+
+  harness_clear_counts();
+  harness_tap(harness_find(LAYER_BASE, keycode));
+
+  const report_keyboard_t *sent = find_report(keycode);
+  HARNESS_CHECK(sent, "no report for %04X", keycode);
+  return *sent;
+}
+
+// Type a space with the nav layer key.
+
+static void space(void) {
+  harness_clear_counts();
+  harness_tap(harness_find(LAYER_BASE, LT_NAV));
+}
+
+static void check_shift_key(uint16_t shift, uint16_t opposite_alpha, const char *name) {
+
+  keypos_t key = harness_find(LAYER_BASE, shift);
+  report_keyboard_t sent;
+  const report_keyboard_t *joiner;
+
+  // One tap shifts the next key on the other hand.
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 1);
+  sent = press(opposite_alpha);
+  HARNESS_CHECK(sent.mods & MOD_MASK_SHIFT, "%s: one tap did not shift the next key", name);
+  sent = press(opposite_alpha);
+  HARNESS_CHECK(! (sent.mods & MOD_MASK_SHIFT), "%s: one tap shifted two keys", name);
+
+  // Two taps toggle caps word in SHOUTING_CASE, which space ends.
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 2);
+  HARNESS_CHECK(is_caps_word_on(), "%s: two taps did not turn caps word on", name);
+  sent = press(KC_T);
+  HARNESS_CHECK(sent.mods & MOD_MASK_SHIFT, "%s: caps word did not shift", name);
+  space();
+  HARNESS_CHECK(! is_caps_word_on(), "%s: space did not end SHOUTING_CASE", name);
+  HARNESS_CHECK(find_report(KC_SPC), "%s: SHOUTING_CASE did not send a space", name);
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 2);
+  tap_times(key, 2);
+  HARNESS_CHECK(! is_caps_word_on(), "%s: two more taps did not turn caps word off", name);
+
+  // Three taps join words with underscores.
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 3);
+  sent = press(KC_T);
+  HARNESS_CHECK(! (sent.mods & MOD_MASK_SHIFT), "%s: snake_case shifted an alpha", name);
+  space();
+  joiner = find_report(KC_MINS);
+  HARNESS_CHECK(joiner && (joiner->mods & MOD_MASK_SHIFT), "%s: snake_case did not send an underscore",
+    name);
+  HARNESS_CHECK(is_caps_word_on(), "%s: space ended snake_case", name);
+
+  // Four taps join words with dashes.
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 4);
+  space();
+  joiner = find_report(KC_MINS);
+  HARNESS_CHECK(joiner && ! (joiner->mods & MOD_MASK_SHIFT), "%s: kebab-case did not send a dash", name);
+  HARNESS_CHECK(is_caps_word_on(), "%s: space ended kebab-case", name);
+
+  // Five taps drop the space and shift the next alpha only.
+
+  harness_reset(OS_LINUX);
+  tap_times(key, 5);
+  sent = press(KC_T);
+  HARNESS_CHECK(! (sent.mods & MOD_MASK_SHIFT), "%s: camelCase shifted the first alpha", name);
+  space();
+  HARNESS_CHECK(! find_report(KC_SPC), "%s: camelCase sent a space", name);
+  sent = press(KC_T);
+  HARNESS_CHECK(sent.mods & MOD_MASK_SHIFT, "%s: camelCase did not shift after a space", name);
+  sent = press(KC_T);
+  HARNESS_CHECK(! (sent.mods & MOD_MASK_SHIFT), "%s: camelCase shifted two alphas", name);
+
+  printf("ok - %s\n", name);
+
+}
+
+int main(void) {
+
+  check_shift_key(OSM_LSFT, KC_N, "left shift");
+  check_shift_key(OSM_RSFT, KC_T, "right shift");
+
+  return 0;
+}
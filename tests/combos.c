@@ -0,0 +1,226 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that combo keys are held back only until they form a combo or cannot,
+// that held back keys are typed in the order they were pressed, and that a
+// combo is never typed ahead of a tap-hold key pressed before it.
+
+#include "harness.h"
+
+// Turn the keyboard reports sent since the counts were cleared into the text
+// they type. Only the keys used by these tests are known.
+
+static const char *typed(void) {
+
+  static char text[HARNESS_REPORT_LOG_SIZE + 1];
+  report_keyboard_t last = { 0 };
+  uint8_t length = 0;
+
+  for (uint32_t i = 0; i < harness_keyboard_reports && i < HARNESS_REPORT_LOG_SIZE; i++) {
+
+    const report_keyboard_t *sent = &harness_reports[i];
+    bool shifted = sent->mods & MOD_MASK_SHIFT;
+
+    for (uint8_t k = 0; k < KEYBOARD_REPORT_KEYS; k++) {
+
+      uint8_t key = sent->keys[k];
+
+      if (! key || harness_report_has_key(&last, key))
+        continue;
+
+      char c = '?';
+      if (key >= KC_A && key <= KC_Z)
+        c = (shifted ? 'A' : 'a') + key - KC_A;
+      else if (key == KC_2 && shifted)
+        c = '"';
+      else if (key == KC_9 && shifted)
+        c = '(';
+      else if (key == KC_MINS)
+        c = shifted ? '_' : '-';
+      else if (key == KC_SPC)
+        c = ' ';
+
+      text[length++] = c;
+    }
+
+    last = *sent;
+  }
+
+  text[length] = 0;
+  return text;
+}
+
+static void expect(const char *description, const char *expected) {
+  const char *actual = typed();
+  HARNESS_CHECK(strcmp(actual, expected) == 0, "%s: typed \"%s\" instead of \"%s\"", description,
+    actual, expected);
+  printf("ok - %s\n", description);
+}
+
+static keypos_t key(uint16_t keycode) {
+  return harness_find(LAYER_BASE, keycode);
+}
+
+// Press two keys the given number of milliseconds apart and release them in
+// the order they were pressed.
+
+static void roll(uint16_t first, uint16_t second, uint16_t gap) {
+  harness_reset(OS_LINUX);
+  harness_event(key(first), true, 1);
+  harness_advance(gap);
+  harness_event(key(second), true, 1);
+  harness_advance(10);
+  harness_event(key(first), false, 1);
+  harness_event(key(second), false, 1);
+}
+
+// Check that nothing has been sent since the counts were cleared.
+
+static void expect_nothing(const char *description) {
+  HARNESS_CHECK(harness_keyboard_reports == 0, "%s: %u reports sent", description,
+    harness_keyboard_reports);
+}
+
+int main(void) {
+
+  roll(KC_W, KC_R, 10);
+  expect("combo sends only its output", "\"");
+  for (uint32_t i = 0; i < harness_keyboard_reports && i < HARNESS_REPORT_LOG_SIZE; i++) {
+    HARNESS_CHECK(! harness_report_has_key(&harness_reports[i], KC_W) &&
+      ! harness_report_has_key(&harness_reports[i], KC_R), "combo sent one of its keys");
+  }
+
+  roll(KC_R, KC_W, 10);
+  expect("combo keys in either order", "\"");
+
+  roll(KC_W, KC_R, COMBO_TERM);
+  expect("second key after the combo term", "wr");
+
+  roll(KC_W, KC_T, 10);
+  expect("keys from different combos", "wt");
+
+  roll(KC_W, KC_S, 10);
+  expect("combo key then a key that is not in a combo", "ws");
+
+  // The first key is released before the second is pressed.
+
+  harness_reset(OS_LINUX);
+  harness_tap(key(KC_W));
+  harness_advance(5);
+  harness_tap(key(KC_R));
+  expect("first key released first", "wr");
+
+  // A combo key is held back until it is released or the combo term passes,
+  // and other keys are not held back at all.
+
+  harness_reset(OS_LINUX);
+  harness_event(key(KC_W), true, 1);
+  expect_nothing("combo key pressed");
+  harness_event(key(KC_W), false, 1);
+  expect("combo key sent when released", "w");
+
+  harness_reset(OS_LINUX);
+  harness_event(key(KC_W), true, 1);
+  harness_advance(COMBO_TERM - 1);
+  expect_nothing("combo key held within the combo term");
+  harness_advance(1);
+  expect("combo key sent after the combo term", "w");
+  harness_event(key(KC_W), false, 1);
+
+  harness_reset(OS_LINUX);
+  harness_event(key(KC_S), true, 1);
+  expect("other keys sent when pressed", "s");
+  harness_event(key(KC_S), false, 1);
+
+  // A homerow modifier is pressed before the combo and released before the
+  // tapping term, so the tapping code holds the combo keys back until it has
+  // decided that the modifier was tapped. Its tap must come first.
+
+  harness_reset(OS_LINUX);
+  keyrecord_t records[] = {
+    harness_record(key(HR_LCTL), true, 1),
+    harness_record(key(KC_W), true, 1),
+    harness_record(key(KC_R), true, 1),
+    harness_record(key(HR_LCTL), false, 1)
+  };
+  for (uint8_t i = 0; i < ARRAY_SIZE(records); i++) {
+    records[i].event.time = timer_read();
+    HARNESS_CHECK(harness_pre_process(&records[i]), "key %u held back before the tapping code", i);
+    harness_advance(5);
+  }
+  for (uint8_t i = 0; i < ARRAY_SIZE(records); i++)
+    action_tapping_process(records[i]);
+  harness_event(key(KC_W), false, 1);
+  harness_event(key(KC_R), false, 1);
+  expect("combo after an undecided tap-hold key", "d\"");
+
+  // Held modifiers turn combos off.
+
+  harness_reset(OS_LINUX);
+  harness_event(key(HR_RCTL), true, 0);
+  harness_clear_counts();
+  harness_event(key(KC_W), true, 1);
+  harness_advance(10);
+  harness_event(key(KC_R), true, 1);
+  harness_event(key(KC_W), false, 1);
+  harness_event(key(KC_R), false, 1);
+  harness_event(key(HR_RCTL), false, 0);
+  expect("no combo while a modifier is held", "wr");
+
+  // A oneshot shift shifts the first key but not the combo output, and is
+  // used up.
+
+  harness_reset(OS_LINUX);
+  harness_tap(key(OSM_RSFT));
+  harness_event(key(KC_P), true, 1);
+  harness_advance(10);
+  harness_event(key(KC_T), true, 1);
+  harness_event(key(KC_P), false, 1);
+  harness_event(key(KC_T), false, 1);
+  harness_tap(key(KC_N));
+  expect("oneshot shift before a combo", "(n");
+
+  harness_reset(OS_LINUX);
+  harness_tap(key(OSM_RSFT));
+  harness_tap(key(KC_W));
+  harness_tap(key(KC_S));
+  expect("oneshot shift before a held back key", "Ws");
+
+  // Caps word sees the keys before they are held back. A held back key keeps
+  // its shift even if the key that lets it go ends caps word, and the combo
+  // output is not shifted.
+
+  harness_reset(OS_LINUX);
+  harness_event(key(OSM_LSFT), true, 1);
+  harness_event(key(OSM_LSFT), false, 1);
+  harness_event(key(OSM_LSFT), true, 2);
+  harness_event(key(OSM_LSFT), false, 2);
+  harness_clear_counts();
+  harness_tap(key(KC_S));
+  harness_event(key(KC_J), true, 1);
+  harness_advance(10);
+  harness_event(key(KC_M), true, 1);
+  harness_event(key(KC_J), false, 1);
+  harness_event(key(KC_M), false, 1);
+  harness_event(key(KC_W), true, 1);
+  harness_tap(key(LT_NAV));
+  harness_event(key(KC_W), false, 1);
+  harness_tap(key(KC_S));
+  expect("combos in SHOUTING_CASE", "S-W s");
+
+  return 0;
+}
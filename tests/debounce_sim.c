@@ -0,0 +1,300 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Matrix scan simulator for the per-key eager press, deferred release debounce.
+// Each key on each half is driven through bounce patterns one millisecond scan
+// at a time and compared with QMK's default symmetric deferred debounce of
+// DEBOUNCE ms. For each key it reports the press latency saved and how often
+// chatter escapes as extra keypresses.
+//
+// Bounces that settle within a key's debounce time must never escape and
+// presses must be reported on the first scan. Noise spikes on a released key
+// are reported but allowed to escape, since an eager press cannot tell them
+// from a real press.
+
+#include "harness.h"
+#include "debounce.h"
+
+#define ROWS_PER_HAND (MATRIX_ROWS / 2)
+#define TIMELINE_LENGTH 256
+#define RANDOM_TRIALS 2000
+
+extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
+
+// A key's raw state for each millisecond scan.
+
+typedef struct {
+  uint8_t raw[TIMELINE_LENGTH];
+  uint16_t length;
+  uint16_t press_time;
+  uint16_t release_time;
+} timeline_t;
+
+// The cooked presses and releases seen for a timeline, when the first press
+// was seen and when the last release was seen.
+
+typedef struct {
+  uint8_t presses;
+  uint8_t releases;
+  int16_t press_time;
+  int16_t release_time;
+} result_t;
+
+static uint32_t random_state = 1;
+
+static uint32_t random_next(void) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return random_state;
+}
+
+static void timeline_add(timeline_t *timeline, uint8_t state, uint16_t ms) {
+  while (ms-- && timeline->length < TIMELINE_LENGTH)
+    timeline->raw[timeline->length++] = state;
+}
+
+// Add a bounce that starts in the given state and lasts for width ms, toggling
+// every ms or at random if random is set. The bounce always ends in the
+// opposite state to the one it starts in.
+
+static void timeline_bounce(timeline_t *timeline, uint8_t start, uint8_t width, bool random) {
+  uint8_t state = start;
+  for (uint8_t i = 0; i < width; i++) {
+    timeline_add(timeline, state, 1);
+    state = random ? random_next() & 1 : ! state;
+  }
+}
+
+// Build a keystroke: idle, a press bounce, a hold with an optional dropout, a
+// release bounce, then idle with an optional noise spike.
+
+static void timeline_keystroke(timeline_t *timeline, uint8_t press_bounce, uint8_t release_bounce,
+    uint8_t dropout, uint8_t spike, bool random) {
+
+  timeline->length = 0;
+  timeline_add(timeline, 0, 10);
+
+  timeline->press_time = timeline->length;
+  timeline_bounce(timeline, 1, press_bounce, random);
+  timeline_add(timeline, 1, 40);
+  timeline_add(timeline, 0, dropout);
+  timeline_add(timeline, 1, 40);
+
+  timeline->release_time = timeline->length;
+  timeline_bounce(timeline, 0, release_bounce, random);
+  timeline_add(timeline, 0, 30);
+  timeline_add(timeline, 1, spike);
+  timeline_add(timeline, 0, 60);
+
+}
+
+// Run a timeline through the userspace debounce for one key.
+
+static result_t run_eager(uint8_t half, uint8_t row, uint8_t col, const timeline_t *timeline) {
+
+  matrix_row_t raw[ROWS_PER_HAND] = { 0 };
+  matrix_row_t cooked[ROWS_PER_HAND] = { 0 };
+  result_t result = { 0, 0, -1, -1 };
+
+  harness_keyboard_left = half == 0;
+  harness_reset_user();
+  debounce_init(ROWS_PER_HAND);
+
+  for (uint16_t t = 0; t < timeline->length; t++) {
+
+    harness_time++;
+
+    matrix_row_t before = raw[row];
+    raw[row] = timeline->raw[t] << col;
+
+    bool was_pressed = cooked[row] & (1 << col);
+    debounce(raw, cooked, ROWS_PER_HAND, raw[row] != before);
+    bool pressed = cooked[row] & (1 << col);
+
+    if (pressed && ! was_pressed) {
+      if (! result.presses++)
+        result.press_time = t;
+    }
+    if (! pressed && was_pressed) {
+      result.releases++;
+      result.release_time = t;
+    }
+  }
+
+  return result;
+}
+
+// QMK's default debounce, which only accepts a change once the key has been
+// stable for DEBOUNCE ms.
+
+static result_t run_baseline(const timeline_t *timeline) {
+
+  uint8_t cooked = 0;
+  uint8_t stable = 0;
+  result_t result = { 0, 0, -1, -1 };
+
+  for (uint16_t t = 0; t < timeline->length; t++) {
+
+    uint8_t raw = timeline->raw[t];
+
+    if (raw == cooked) {
+      stable = 0;
+      continue;
+    }
+
+    if (++stable < DEBOUNCE)
+      continue;
+
+    stable = 0;
+    cooked = raw;
+
+    if (cooked && ! result.presses++)
+      result.press_time = t;
+    if (! cooked) {
+      result.releases++;
+      result.release_time = t;
+    }
+  }
+
+  return result;
+}
+
+// Totals for one key over all of its patterns.
+
+typedef struct {
+  uint32_t keystrokes;
+  uint32_t escapes;
+  uint32_t baseline_escapes;
+  int32_t press_latency;
+  int32_t baseline_press_latency;
+  int32_t release_latency;
+  int32_t baseline_release_latency;
+  uint32_t spikes;
+  uint32_t spike_escapes;
+} key_stats_t;
+
+// Run a keystroke that must be debounced cleanly and add it to the totals.
+
+static void check_keystroke(uint8_t half, uint8_t row, uint8_t col, const timeline_t *timeline,
+    key_stats_t *stats, const char *name) {
+
+  result_t eager = run_eager(half, row, col, timeline);
+  result_t baseline = run_baseline(timeline);
+
+  stats->keystrokes++;
+  stats->escapes += eager.presses - 1;
+  stats->baseline_escapes += baseline.presses - 1;
+
+  HARNESS_CHECK(eager.presses == 1 && eager.releases == 1,
+    "key %u,%u %s: %u presses and %u releases", half * ROWS_PER_HAND + row, col, name,
+    eager.presses, eager.releases);
+  HARNESS_CHECK(eager.press_time == timeline->press_time,
+    "key %u,%u %s: press reported after %d ms", half * ROWS_PER_HAND + row, col, name,
+    eager.press_time - timeline->press_time);
+
+  stats->press_latency += eager.press_time - timeline->press_time;
+  stats->baseline_press_latency += baseline.press_time - timeline->press_time;
+  stats->release_latency += eager.release_time - timeline->release_time;
+  stats->baseline_release_latency += baseline.release_time - timeline->release_time;
+
+}
+
+int main(void) {
+
+  timeline_t timeline;
+  key_stats_t totals = { 0 };
+
+  printf("%-7s %-7s %4s %13s %8s %15s %15s %13s\n", "key", "keycode", "time", "press ms",
+    "saved ms", "release ms", "chatter", "spikes");
+
+  for (uint8_t half = 0; half < 2; half++) {
+    for (uint8_t row = 0; row < ROWS_PER_HAND; row++) {
+      for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+
+        uint8_t matrix_row = half * ROWS_PER_HAND + row;
+        uint16_t keycode = keymaps[LAYER_BASE][matrix_row][col];
+
+        if (keycode == KC_NO)
+          continue;
+
+        uint8_t time = debounce_times[matrix_row][col];
+        key_stats_t stats = { 0 };
+
+        HARNESS_CHECK(time > 1 && time < 128, "key %u,%u: debounce time %u", matrix_row, col, time);
+
+        // Regular bounces of every width that settles within the debounce
+        // time, on the press, the release and both, and dropouts while held.
+
+        for (uint8_t width = 0; width < time; width++) {
+          timeline_keystroke(&timeline, width, 0, 0, 0, false);
+          check_keystroke(half, row, col, &timeline, &stats, "press bounce");
+          timeline_keystroke(&timeline, 0, width, 0, 0, false);
+          check_keystroke(half, row, col, &timeline, &stats, "release bounce");
+          timeline_keystroke(&timeline, width, width, 0, 0, false);
+          check_keystroke(half, row, col, &timeline, &stats, "press and release bounce");
+          timeline_keystroke(&timeline, 0, 0, width, 0, false);
+          check_keystroke(half, row, col, &timeline, &stats, "dropout");
+        }
+
+        // Random bounces that settle within the debounce time.
+
+        for (uint32_t trial = 0; trial < RANDOM_TRIALS; trial++) {
+          timeline_keystroke(&timeline, random_next() % time, random_next() % time,
+            random_next() % time, 0, true);
+          check_keystroke(half, row, col, &timeline, &stats, "random bounce");
+        }
+
+        // Noise spikes on a released key.
+
+        for (uint8_t width = 1; width <= time; width++) {
+          timeline_keystroke(&timeline, 0, 0, 0, width, false);
+          result_t eager = run_eager(half, row, col, &timeline);
+          stats.spikes++;
+          stats.spike_escapes += eager.presses - 1;
+        }
+
+        printf("%u,%u     %04X    %4u %6.2f / %4.2f %8.2f %6.2f / %6.2f %6u / %6u %6u / %4u\n",
+          matrix_row, col, keycode, time,
+          (double)stats.press_latency / stats.keystrokes,
+          (double)stats.baseline_press_latency / stats.keystrokes,
+          (double)(stats.baseline_press_latency - stats.press_latency) / stats.keystrokes,
+          (double)stats.release_latency / stats.keystrokes,
+          (double)stats.baseline_release_latency / stats.keystrokes,
+          stats.escapes, stats.baseline_escapes, stats.spike_escapes, stats.spikes);
+
+        totals.keystrokes += stats.keystrokes;
+        totals.escapes += stats.escapes;
+        totals.baseline_escapes += stats.baseline_escapes;
+        totals.press_latency += stats.press_latency;
+        totals.baseline_press_latency += stats.baseline_press_latency;
+        totals.spikes += stats.spikes;
+        totals.spike_escapes += stats.spike_escapes;
+
+      }
+    }
+  }
+
+  printf("\n%u keystrokes: %u chatter escapes (%u with the default debounce), "
+    "%.2f ms mean press latency saved\n", totals.keystrokes, totals.escapes,
+    totals.baseline_escapes,
+    (double)(totals.baseline_press_latency - totals.press_latency) / totals.keystrokes);
+  printf("%u noise spikes on released keys: %u escaped as keypresses (%.1f%%)\n",
+    totals.spikes, totals.spike_escapes, 100.0 * totals.spike_escapes / totals.spikes);
+
+  return 0;
+}
@@ -0,0 +1,773 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host implementations of the QMK functions used by the userspace. These follow
+// QMK closely wherever it changes the reports that are sent, so that report
+// counts and modifier state match the keyboard.
+
+#include "harness.h"
+#include "raw_hid.h"
+
+extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
+
+// Fake clock.
+
+uint32_t harness_time = 0;
+uint32_t harness_delay = 0;
+
+uint16_t timer_read(void) {
+  return harness_time;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+  return (uint16_t)(harness_time - last);
+}
+
+uint32_t timer_read32(void) {
+  return harness_time;
+}
+
+uint32_t timer_elapsed32(uint32_t last) {
+  return harness_time - last;
+}
+
+fast_timer_t timer_read_fast(void) {
+  return harness_time;
+}
+
+fast_timer_t timer_elapsed_fast(fast_timer_t last) {
+  return harness_time - last;
+}
+
+void wait_ms(uint32_t ms) {
+  harness_time += ms;
+  harness_delay += ms;
+}
+
+// Matrix.
+
+matrix_row_t harness_matrix[MATRIX_ROWS];
+bool harness_keyboard_left = true;
+
+matrix_row_t matrix_get_row(uint8_t row) {
+  return harness_matrix[row];
+}
+
+bool is_keyboard_left(void) {
+  return harness_keyboard_left;
+}
+
+// Modifiers.
+
+static uint8_t real_mods = 0;
+static uint8_t weak_mods = 0;
+static uint8_t oneshot_mods = 0;
+
+uint8_t get_mods(void) {
+  return real_mods;
+}
+
+void add_mods(uint8_t mods) {
+  real_mods |= mods;
+}
+
+void del_mods(uint8_t mods) {
+  real_mods &= ~mods;
+}
+
+void set_mods(uint8_t mods) {
+  real_mods = mods;
+}
+
+void clear_mods(void) {
+  real_mods = 0;
+}
+
+void register_mods(uint8_t mods) {
+  if (mods) {
+    add_mods(mods);
+    send_keyboard_report();
+  }
+}
+
+void unregister_mods(uint8_t mods) {
+  if (mods) {
+    del_mods(mods);
+    send_keyboard_report();
+  }
+}
+
+uint8_t get_weak_mods(void) {
+  return weak_mods;
+}
+
+void add_weak_mods(uint8_t mods) {
+  weak_mods |= mods;
+}
+
+void del_weak_mods(uint8_t mods) {
+  weak_mods &= ~mods;
+}
+
+void set_weak_mods(uint8_t mods) {
+  weak_mods = mods;
+}
+
+void clear_weak_mods(void) {
+  weak_mods = 0;
+}
+
+static void register_weak_mods(uint8_t mods) {
+  if (mods) {
+    add_weak_mods(mods);
+    send_keyboard_report();
+  }
+}
+
+static void unregister_weak_mods(uint8_t mods) {
+  if (mods) {
+    del_weak_mods(mods);
+    send_keyboard_report();
+  }
+}
+
+uint8_t get_oneshot_mods(void) {
+  return oneshot_mods;
+}
+
+void add_oneshot_mods(uint8_t mods) {
+  oneshot_mods |= mods;
+}
+
+void del_oneshot_mods(uint8_t mods) {
+  oneshot_mods &= ~mods;
+}
+
+void clear_oneshot_mods(void) {
+  oneshot_mods = 0;
+}
+
+// Convert the five bit modifiers used by mod-tap and oneshot keycodes to eight
+// bit modifiers.
+
+static uint8_t mod_config(uint8_t mods) {
+  return mods & 0x10 ? (mods & 0x0F) << 4 : mods & 0x0F;
+}
+
+// Layers.
+
+layer_state_t layer_state = 0;
+
+uint8_t get_highest_layer(layer_state_t state) {
+  uint8_t layer = 0;
+  while (state >>= 1)
+    layer++;
+  return layer;
+}
+
+void layer_on(uint8_t layer) {
+  layer_state |= (layer_state_t)1 << layer;
+}
+
+void layer_off(uint8_t layer) {
+  layer_state &= ~((layer_state_t)1 << layer);
+}
+
+uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key) {
+  return keymaps[layer][key.row][key.col];
+}
+
+// The keycode of a key on the highest active layer where it is not
+// transparent, and the keycode each key was pressed with so that its release
+// uses the same keycode.
+
+static uint16_t layer_keycode(keypos_t key) {
+  for (int8_t layer = get_highest_layer(layer_state); layer > 0; layer--) {
+    if (! (layer_state & ((layer_state_t)1 << layer)))
+      continue;
+    uint16_t keycode = keymap_key_to_keycode(layer, key);
+    if (keycode != KC_TRNS)
+      return keycode;
+  }
+  return keymap_key_to_keycode(0, key);
+}
+
+static uint16_t pressed_keycodes[MATRIX_ROWS][MATRIX_COLS];
+
+static uint16_t record_keycode(keyrecord_t *record) {
+  keypos_t key = record->event.key;
+  if (record->event.pressed)
+    pressed_keycodes[key.row][key.col] = layer_keycode(key);
+  return pressed_keycodes[key.row][key.col];
+}
+
+// Keyboard reports.
+
+static report_keyboard_t report;
+report_keyboard_t *keyboard_report = &report;
+
+uint32_t harness_keyboard_reports = 0;
+uint32_t harness_mouse_reports = 0;
+uint32_t harness_raw_hid_reports = 0;
+report_keyboard_t harness_last_report;
+report_mouse_t harness_last_mouse_report;
+void (*harness_raw_hid_send)(uint8_t *data, uint8_t length) = NULL;
+
+report_keyboard_t harness_reports[HARNESS_REPORT_LOG_SIZE];
+
+static void harness_send_keyboard(report_keyboard_t *sent) {
+  if (harness_keyboard_reports < HARNESS_REPORT_LOG_SIZE)
+    harness_reports[harness_keyboard_reports] = *sent;
+  harness_keyboard_reports++;
+  harness_last_report = *sent;
+}
+
+bool harness_report_has_key(const report_keyboard_t *sent, uint8_t key) {
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (sent->keys[i] == key)
+      return true;
+  }
+  return false;
+}
+
+static void harness_send_mouse(report_mouse_t *sent) {
+  harness_mouse_reports++;
+  harness_last_mouse_report = *sent;
+}
+
+static host_driver_t harness_driver = {
+  .send_keyboard = harness_send_keyboard,
+  .send_mouse = harness_send_mouse
+};
+
+static host_driver_t *driver = &harness_driver;
+
+void harness_clear_counts(void) {
+  harness_keyboard_reports = 0;
+  harness_mouse_reports = 0;
+  harness_raw_hid_reports = 0;
+  harness_delay = 0;
+}
+
+host_driver_t *host_get_driver(void) {
+  return driver;
+}
+
+void host_set_driver(host_driver_t *new_driver) {
+  driver = new_driver;
+}
+
+void host_mouse_send(report_mouse_t *sent) {
+  driver->send_mouse(sent);
+}
+
+report_mouse_t mousekey_get_report(void) {
+  return (report_mouse_t){ 0 };
+}
+
+static bool has_anykey(void) {
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (report.keys[i])
+      return true;
+  }
+  return false;
+}
+
+// Oneshot mods are sent with the next report and cleared once that report has
+// a key in it, as in QMK.
+
+void send_keyboard_report(void) {
+  report.mods = real_mods | weak_mods;
+  if (oneshot_mods) {
+    report.mods |= oneshot_mods;
+    if (has_anykey())
+      clear_oneshot_mods();
+  }
+  driver->send_keyboard(&report);
+}
+
+static void add_key(uint8_t code) {
+  int8_t empty = -1;
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (report.keys[i] == code)
+      return;
+    if (empty < 0 && ! report.keys[i])
+      empty = i;
+  }
+  if (empty >= 0)
+    report.keys[empty] = code;
+}
+
+static void del_key(uint8_t code) {
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (report.keys[i] == code)
+      report.keys[i] = 0;
+  }
+}
+
+// Mouse and consumer keys go out in their own reports, which the userspace
+// does not look at, so they only need to stay out of the keyboard report.
+
+void register_code(uint8_t code) {
+  if (code == KC_NO || IS_MOUSE_KEYCODE(code) || IS_CONSUMER_KEYCODE(code))
+    return;
+  if (IS_MODIFIER_KEYCODE(code))
+    add_mods(MOD_BIT(code));
+  else
+    add_key(code);
+  send_keyboard_report();
+}
+
+void unregister_code(uint8_t code) {
+  if (code == KC_NO || IS_MOUSE_KEYCODE(code) || IS_CONSUMER_KEYCODE(code))
+    return;
+  if (IS_MODIFIER_KEYCODE(code))
+    del_mods(MOD_BIT(code));
+  else
+    del_key(code);
+  send_keyboard_report();
+}
+
+void tap_code(uint8_t code) {
+  register_code(code);
+  unregister_code(code);
+}
+
+// The modifiers in a 16 bit keycode are weak unless the keycode is itself a
+// modifier, as in QMK.
+
+static uint8_t code16_mods(uint16_t code) {
+  uint8_t mods = (code >> 8) & 0x0F;
+  return code & QK_RMODS_MIN ? mods << 4 : mods;
+}
+
+void register_code16(uint16_t code) {
+  if (IS_MODIFIER_KEYCODE(code) || code == KC_NO)
+    register_mods(code16_mods(code));
+  else
+    register_weak_mods(code16_mods(code));
+  register_code(code);
+}
+
+void unregister_code16(uint16_t code) {
+  unregister_code(code);
+  if (IS_MODIFIER_KEYCODE(code) || code == KC_NO)
+    unregister_mods(code16_mods(code));
+  else
+    unregister_weak_mods(code16_mods(code));
+}
+
+void tap_code16(uint16_t code) {
+  register_code16(code);
+  unregister_code16(code);
+}
+
+// Send string. Only the characters the userspace sends are supported.
+
+static uint16_t ascii_keycode(char c) {
+  if (c >= 'a' && c <= 'z')
+    return KC_A + c - 'a';
+  if (c >= 'A' && c <= 'Z')
+    return LSFT(KC_A + c - 'A');
+  if (c >= '1' && c <= '9')
+    return KC_1 + c - '1';
+  switch (c) {
+    case '0':
+      return KC_0;
+    case ' ':
+      return KC_SPC;
+    case ':':
+      return KC_COLN;
+    case ';':
+      return KC_SCLN;
+  }
+  fprintf(stderr, "send_string: unsupported character %02X\n", c);
+  exit(1);
+}
+
+void send_string(const char *string) {
+  while (*string) {
+
+    if (*string != SS_QMK_PREFIX) {
+      uint16_t keycode = ascii_keycode(*string++);
+      if (keycode & QK_LSFT)
+        register_code(KC_LSFT);
+      tap_code(keycode & 0xFF);
+      if (keycode & QK_LSFT)
+        unregister_code(KC_LSFT);
+      continue;
+    }
+
+    uint8_t code = *++string;
+    string++;
+
+    if (code == SS_DELAY_CODE) {
+      uint32_t ms = 0;
+      while (*string && *string != '|')
+        ms = ms * 10 + *string++ - '0';
+      if (*string)
+        string++;
+      wait_ms(ms);
+      continue;
+    }
+
+    uint8_t keycode = *string++;
+
+    switch (code) {
+      case SS_TAP_CODE:
+        tap_code(keycode);
+        break;
+      case SS_DOWN_CODE:
+        register_code(keycode);
+        break;
+      case SS_UP_CODE:
+        unregister_code(keycode);
+        break;
+    }
+  }
+}
+
+// Caps word, as in QMK but without the double tap shift and idle timeout
+// handling, which the userspace does itself.
+
+static bool caps_word_active = false;
+
+bool is_caps_word_on(void) {
+  return caps_word_active;
+}
+
+void caps_word_on(void) {
+  if (caps_word_active)
+    return;
+  clear_mods();
+  clear_oneshot_mods();
+  caps_word_active = true;
+  caps_word_set_user(true);
+}
+
+void caps_word_off(void) {
+  if (! caps_word_active)
+    return;
+  unregister_weak_mods(MOD_MASK_SHIFT);
+  caps_word_active = false;
+  caps_word_set_user(false);
+}
+
+void caps_word_toggle(void) {
+  if (caps_word_active)
+    caps_word_off();
+  else
+    caps_word_on();
+}
+
+static bool process_caps_word(uint16_t keycode, keyrecord_t *record) {
+
+  if (! caps_word_active || ! record->event.pressed)
+    return true;
+
+  if ((get_mods() | get_oneshot_mods()) & ~MOD_MASK_SHIFT) {
+    caps_word_off();
+    return true;
+  }
+
+  if (IS_MODIFIER_KEYCODE(keycode) || IS_QK_ONE_SHOT_MOD(keycode))
+    return true;
+
+  if (IS_QK_MOD_TAP(keycode) || IS_QK_LAYER_TAP(keycode)) {
+    if (! record->tap.count)
+      return true;
+    keycode &= 0xFF;
+  }
+
+  clear_weak_mods();
+
+  if (caps_word_press_user(keycode)) {
+    send_keyboard_report();
+    return true;
+  }
+
+  caps_word_off();
+  return true;
+}
+
+// Deferred execution. Callbacks run from harness_advance, in trigger order.
+
+#define HARNESS_DEFERRED_SIZE 16
+
+typedef struct {
+  deferred_token token;
+  uint32_t trigger_time;
+  deferred_exec_callback callback;
+  void *cb_arg;
+} deferred_entry_t;
+
+static deferred_entry_t deferred_entries[HARNESS_DEFERRED_SIZE];
+static deferred_token last_token = 0;
+
+static deferred_entry_t *find_deferred(deferred_token token) {
+  if (token == INVALID_DEFERRED_TOKEN)
+    return NULL;
+  for (uint8_t i = 0; i < HARNESS_DEFERRED_SIZE; i++) {
+    if (deferred_entries[i].token == token)
+      return &deferred_entries[i];
+  }
+  return NULL;
+}
+
+deferred_token defer_exec(uint32_t delay_ms, deferred_exec_callback callback, void *cb_arg) {
+
+  if (! delay_ms)
+    return INVALID_DEFERRED_TOKEN;
+
+  deferred_entry_t *entry = NULL;
+
+  for (uint8_t i = 0; ! entry && i < HARNESS_DEFERRED_SIZE; i++) {
+    if (deferred_entries[i].token == INVALID_DEFERRED_TOKEN)
+      entry = &deferred_entries[i];
+  }
+
+  if (! entry)
+    return INVALID_DEFERRED_TOKEN;
+
+  do {
+    last_token++;
+  } while (last_token == INVALID_DEFERRED_TOKEN || find_deferred(last_token));
+
+  *entry = (deferred_entry_t){ last_token, harness_time + delay_ms, callback, cb_arg };
+  return last_token;
+}
+
+bool extend_deferred_exec(deferred_token token, uint32_t delay_ms) {
+  deferred_entry_t *entry = find_deferred(token);
+  if (! entry)
+    return false;
+  entry->trigger_time = harness_time + delay_ms;
+  return true;
+}
+
+bool cancel_deferred_exec(deferred_token token) {
+  deferred_entry_t *entry = find_deferred(token);
+  if (! entry)
+    return false;
+  entry->token = INVALID_DEFERRED_TOKEN;
+  return true;
+}
+
+static deferred_entry_t *next_deferred(void) {
+  deferred_entry_t *next = NULL;
+  for (uint8_t i = 0; i < HARNESS_DEFERRED_SIZE; i++) {
+    deferred_entry_t *entry = &deferred_entries[i];
+    if (entry->token && (! next || entry->trigger_time < next->trigger_time))
+      next = entry;
+  }
+  return next;
+}
+
+// Move the clock on, running each deferred callback when it is due followed by
+// the housekeeping task, as the keyboard does after each matrix scan.
+
+void harness_advance(uint32_t ms) {
+
+  uint32_t target = harness_time + ms;
+  deferred_entry_t *entry;
+
+  while ((entry = next_deferred()) && entry->trigger_time <= target) {
+
+    deferred_token token = entry->token;
+
+    if (entry->trigger_time > harness_time)
+      harness_time = entry->trigger_time;
+
+    uint32_t delay = entry->callback(entry->trigger_time, entry->cb_arg);
+
+    if (entry->token == token) {
+      if (delay)
+        entry->trigger_time += delay;
+      else
+        entry->token = INVALID_DEFERRED_TOKEN;
+    }
+
+    housekeeping_task_user();
+  }
+
+  if (target > harness_time)
+    harness_time = target;
+
+  housekeeping_task_user();
+}
+
+// EEPROM.
+
+uint8_t harness_eeprom[EECONFIG_USER_DATA_SIZE];
+
+void eeconfig_read_user_datablock(void *data) {
+  memcpy(data, harness_eeprom, EECONFIG_USER_DATA_SIZE);
+}
+
+void eeconfig_update_user_datablock(const void *data) {
+  memcpy(harness_eeprom, data, EECONFIG_USER_DATA_SIZE);
+}
+
+// Raw HID.
+
+void raw_hid_send(uint8_t *data, uint8_t length) {
+  harness_raw_hid_reports++;
+  if (harness_raw_hid_send)
+    harness_raw_hid_send(data, length);
+}
+
+// QMK's default for when the userspace does not look at keypresses before the
+// tapping code.
+
+__attribute__((weak)) bool pre_process_record_user(uint16_t keycode, keyrecord_t *record) {
+  return true;
+}
+
+// The default QMK actions for a keycode once the userspace has let it through.
+
+static void process_action(uint16_t keycode, keyrecord_t *record) {
+
+  bool pressed = record->event.pressed;
+  bool tap = record->tap.count > 0;
+
+  if (keycode <= 0xFF) {
+    if (pressed)
+      register_code(keycode);
+    else
+      unregister_code(keycode);
+  } else if (IS_QK_MODS(keycode)) {
+    if (pressed)
+      register_code16(keycode);
+    else
+      unregister_code16(keycode);
+  } else if (IS_QK_MOD_TAP(keycode)) {
+    uint8_t mods = mod_config(QK_MOD_TAP_GET_MODS(keycode));
+    if (tap && pressed)
+      register_code(keycode & 0xFF);
+    else if (tap)
+      unregister_code(keycode & 0xFF);
+    else if (pressed)
+      register_mods(mods);
+    else
+      unregister_mods(mods);
+  } else if (IS_QK_LAYER_TAP(keycode)) {
+    uint8_t layer = QK_LAYER_TAP_GET_LAYER(keycode);
+    if (tap && pressed)
+      register_code(keycode & 0xFF);
+    else if (tap)
+      unregister_code(keycode & 0xFF);
+    else if (pressed)
+      layer_on(layer);
+    else
+      layer_off(layer);
+  } else if (IS_QK_ONE_SHOT_MOD(keycode)) {
+    uint8_t mods = mod_config(QK_ONE_SHOT_MOD_GET_MODS(keycode));
+    if (record->tap.count == 1) {
+      if (pressed)
+        add_oneshot_mods(mods);
+    } else if (pressed) {
+      register_mods(mods);
+    } else {
+      unregister_mods(mods);
+    }
+  }
+}
+
+// The tapping code has decided the key's tap count, so process it as QMK does
+// from process_record onwards. Caps word sees each key before the userspace
+// does, as it comes before process_record_user in process_record_quantum.
+
+void action_tapping_process(keyrecord_t record) {
+
+  uint16_t keycode = record_keycode(&record);
+
+  if (record.event.pressed)
+    clear_weak_mods();
+
+  if (! process_caps_word(keycode, &record))
+    return;
+
+  if (! process_record_user(keycode, &record))
+    return;
+
+  process_action(keycode, &record);
+}
+
+keyrecord_t harness_record(keypos_t key, bool pressed, uint8_t tap_count) {
+  return (keyrecord_t){
+    .event = { .key = key, .pressed = pressed, .time = timer_read() },
+    .tap = { .count = tap_count }
+  };
+}
+
+bool harness_pre_process(keyrecord_t *record) {
+  return pre_process_record_user(record_keycode(record), record);
+}
+
+void harness_event(keypos_t key, bool pressed, uint8_t tap_count) {
+  keyrecord_t record = harness_record(key, pressed, tap_count);
+  if (harness_pre_process(&record))
+    action_tapping_process(record);
+}
+
+void harness_tap(keypos_t key) {
+  harness_event(key, true, 1);
+  harness_event(key, false, 1);
+}
+
+keypos_t harness_find(uint8_t layer, uint16_t keycode) {
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+      if (keymaps[layer][row][col] == keycode)
+        return (keypos_t){ .col = col, .row = row };
+    }
+  }
+  fprintf(stderr, "keycode %04X is not on layer %u\n", keycode, layer);
+  exit(1);
+}
+
+// Start from a freshly flashed keyboard with the given operating system
+// selected.
+
+void harness_reset(uint8_t os) {
+
+  harness_time = 1000;
+  real_mods = 0;
+  weak_mods = 0;
+  oneshot_mods = 0;
+  layer_state = 0;
+  caps_word_active = false;
+  driver = &harness_driver;
+  memset(&report, 0, sizeof(report));
+  memset(&harness_last_report, 0, sizeof(harness_last_report));
+  memset(&harness_last_mouse_report, 0, sizeof(harness_last_mouse_report));
+  memset(pressed_keycodes, 0, sizeof(pressed_keycodes));
+  memset(deferred_entries, 0, sizeof(deferred_entries));
+  memset(harness_matrix, 0, sizeof(harness_matrix));
+  memset(harness_eeprom, 0, sizeof(harness_eeprom));
+  harness_raw_hid_send = NULL;
+
+  harness_reset_user();
+  keyboard_post_init_user();
+
+  keyrecord_t record = { .event = { .pressed = true } };
+  process_record_user(M_ISWINDOWS + os, &record);
+  record.event.pressed = false;
+  process_record_user(M_ISWINDOWS + os, &record);
+
+  harness_clear_counts();
+}
@@ -0,0 +1,114 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host test harness. The userspace is built against the QMK stubs in qmk/,
+// with a fake clock, a fake deferred exec, a fake EEPROM and a host driver
+// that records every report sent. Key events are fed in with the tap count
+// already decided, as the QMK tapping code would deliver them.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hbmorrison.h"
+
+// The fake clock in milliseconds. harness_advance runs any deferred exec
+// callbacks and the housekeeping task as time passes. Time spent in wait_ms
+// and SS_DELAY is added to harness_delay and moves the clock without running
+// them, since the keyboard is blocked while it waits.
+
+extern uint32_t harness_time;
+extern uint32_t harness_delay;
+
+void harness_advance(uint32_t ms);
+
+// Counts of the keyboard, mouse and raw HID reports sent, and the last
+// keyboard and mouse reports. harness_raw_hid_send is called for each raw HID
+// report if it is set.
+
+extern uint32_t harness_keyboard_reports;
+extern uint32_t harness_mouse_reports;
+extern uint32_t harness_raw_hid_reports;
+extern report_keyboard_t harness_last_report;
+extern report_mouse_t harness_last_mouse_report;
+
+// The first HARNESS_REPORT_LOG_SIZE keyboard reports since the counts were
+// last cleared, and whether a keyboard report has a key pressed.
+
+#define HARNESS_REPORT_LOG_SIZE 64
+
+extern report_keyboard_t harness_reports[HARNESS_REPORT_LOG_SIZE];
+
+bool harness_report_has_key(const report_keyboard_t *sent, uint8_t key);
+extern void (*harness_raw_hid_send)(uint8_t *data, uint8_t length);
+
+void harness_clear_counts(void);
+
+// The fake EEPROM user datablock.
+
+extern uint8_t harness_eeprom[EECONFIG_USER_DATA_SIZE];
+
+// The matrix rows returned by matrix_get_row and which half this is.
+
+extern matrix_row_t harness_matrix[MATRIX_ROWS];
+extern bool harness_keyboard_left;
+
+// Reset the QMK state and the userspace state, including the EEPROM, then start
+// up as the keyboard does and select the operating system.
+
+void harness_reset(uint8_t os);
+
+// Reset every static in hbmorrison.c to its initial value. Defined alongside
+// the userspace build in userspace.c.
+
+void harness_reset_user(void);
+
+// Name the first piece of userspace state that tracks a held key or a running
+// action and is still set, or return NULL if there is none. Also defined in
+// userspace.c.
+
+const char *harness_user_held(void);
+
+// Key events. harness_event runs the whole pipeline, pre_process_record_user
+// then the tapping code, and the tapping code goes on to process_record_user
+// and the default QMK actions. A tap count of zero means a tap-hold key was
+// held. harness_pre_process and action_tapping_process can be called
+// separately to model keypresses held back by the tapping code.
+
+keyrecord_t harness_record(keypos_t key, bool pressed, uint8_t tap_count);
+void harness_event(keypos_t key, bool pressed, uint8_t tap_count);
+bool harness_pre_process(keyrecord_t *record);
+
+// Tap a key, pressing and releasing it with a tap count of one.
+
+void harness_tap(keypos_t key);
+
+// Find the position of a keycode on a layer. Exits if it is not there.
+
+keypos_t harness_find(uint8_t layer, uint16_t keycode);
+
+// Check a condition and exit with a message if it fails.
+
+#define HARNESS_CHECK(cond, ...) do { \
+  if (! (cond)) { \
+    fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+    fprintf(stderr, __VA_ARGS__); \
+    fprintf(stderr, "\n"); \
+    exit(1); \
+  } \
+} while (0)
@@ -0,0 +1,126 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A fake hidraw device for testing hbm_tune.py. It opens a pseudo terminal,
+// prints the path of its slave end and then answers raw HID requests written
+// to it with the userspace raw_hid_receive, as the keyboard would.
+//
+// Requests are written as a report ID of zero followed by a 32 byte report,
+// and responses are read back as a 32 byte report, as with a real hidraw
+// device. SIGUSR1 restarts the keyboard, keeping only the EEPROM, and prints
+// a line once it has restarted.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "harness.h"
+#include "raw_hid.h"
+
+static int master = -1;
+static volatile sig_atomic_t restart_requested = 0;
+
+static void write_report(uint8_t *data, uint8_t length) {
+
+  while (length) {
+    ssize_t written = write(master, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    HARNESS_CHECK(written > 0, "write failed: %s", strerror(errno));
+    data += written;
+    length -= written;
+  }
+
+}
+
+static void restart(void) {
+
+  uint8_t eeprom[EECONFIG_USER_DATA_SIZE];
+
+  memcpy(eeprom, harness_eeprom, sizeof(eeprom));
+  harness_reset(OS_LINUX);
+  memcpy(harness_eeprom, eeprom, sizeof(eeprom));
+  keyboard_post_init_user();
+  harness_raw_hid_send = write_report;
+
+}
+
+static void handle_sigusr1(int signal) {
+  restart_requested = 1;
+}
+
+int main(void) {
+
+  uint8_t request[1 + HID_REPORT_SIZE];
+  size_t received = 0;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  HARNESS_CHECK(master >= 0, "posix_openpt failed: %s", strerror(errno));
+  HARNESS_CHECK(grantpt(master) == 0 && unlockpt(master) == 0, "unlockpt failed: %s",
+    strerror(errno));
+
+  // Keep the slave end open so that the master does not see a hangup each time
+  // a client closes it, and put it in raw mode so that reports pass through
+  // unchanged.
+
+  const char *path = ptsname(master);
+  int slave = open(path, O_RDWR | O_NOCTTY);
+  HARNESS_CHECK(slave >= 0, "open %s failed: %s", path, strerror(errno));
+
+  struct termios termios;
+  tcgetattr(slave, &termios);
+  cfmakeraw(&termios);
+  tcsetattr(slave, TCSANOW, &termios);
+
+  struct sigaction action = { .sa_handler = handle_sigusr1 };
+  sigaction(SIGUSR1, &action, NULL);
+
+  harness_reset(OS_LINUX);
+  harness_raw_hid_send = write_report;
+
+  printf("%s\n", path);
+  fflush(stdout);
+
+  for (;;) {
+
+    ssize_t length = read(master, request + received, sizeof(request) - received);
+
+    if (restart_requested) {
+      restart_requested = 0;
+      restart();
+      printf("restarted\n");
+      fflush(stdout);
+    }
+
+    if (length < 0 && errno == EINTR)
+      continue;
+    HARNESS_CHECK(length > 0, "read failed: %s", strerror(errno));
+
+    received += length;
+    if (received < sizeof(request))
+      continue;
+    received = 0;
+
+    raw_hid_receive(request + 1, HID_REPORT_SIZE);
+
+  }
+
+}
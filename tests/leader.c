@@ -0,0 +1,83 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that leader sequences send the action for the selected operating
+// system, and that the keys consumed by a sequence send nothing at all, not
+// even when they are released.
+
+#include "harness.h"
+
+// Start a leader sequence with the leader key on the controls layer.
+
+static void leader(void) {
+  keypos_t layer_key = harness_find(LAYER_BASE, LT_CTLS);
+  harness_event(layer_key, true, 0);
+  harness_tap(harness_find(LAYER_CTLS, M_LEADER));
+  harness_event(layer_key, false, 0);
+  harness_clear_counts();
+}
+
+// Tap the keys of a leader sequence and return the number of keyboard reports
+// sent. Homerow modifier keys are tapped, so they give their alpha keycode.
+
+static uint32_t sequence(uint8_t os, const uint16_t *keycodes, uint8_t length) {
+  harness_reset(os);
+  leader();
+  for (uint8_t i = 0; i < length; i++)
+    harness_tap(harness_find(LAYER_BASE, keycodes[i]));
+  return harness_keyboard_reports;
+}
+
+int main(void) {
+
+  // Tapping the same keycode directly gives the number of reports the action
+  // itself sends.
+
+  const uint16_t next_desktop[] = { HR_LCTL, KC_N };
+
+  for (uint8_t os = OS_WINDOWS; os <= OS_LINUX; os++) {
+
+    harness_reset(os);
+    layer_on(LAYER_NAV);
+    harness_tap(harness_find(LAYER_NAV, M_NDESK));
+    uint32_t expected = harness_keyboard_reports;
+
+    uint32_t reports = sequence(os, next_desktop, ARRAY_SIZE(next_desktop));
+    HARNESS_CHECK(reports == expected, "leader d n on os %u sent %u reports instead of %u", os,
+      reports, expected);
+    HARNESS_CHECK(harness_last_report.mods == 0 && ! harness_last_report.keys[0],
+      "leader d n on os %u left keys held", os);
+  }
+  printf("ok - sequence sends only the action\n");
+
+  const uint16_t no_sequence[] = { KC_Q };
+  HARNESS_CHECK(sequence(OS_LINUX, no_sequence, ARRAY_SIZE(no_sequence)) == 0,
+    "a key that is not in a sequence sent reports");
+  harness_tap(harness_find(LAYER_BASE, KC_S));
+  HARNESS_CHECK(harness_report_has_key(&harness_reports[0], KC_S), "leader did not end");
+  printf("ok - key that is not in a sequence ends it and is consumed\n");
+
+  const uint16_t prefix[] = { HR_LCTL };
+  HARNESS_CHECK(sequence(OS_LINUX, prefix, ARRAY_SIZE(prefix)) == 0, "prefix sent reports");
+  harness_advance(LEADER_TIMEOUT);
+  HARNESS_CHECK(harness_keyboard_reports == 0, "prefix without an action sent reports");
+  harness_tap(harness_find(LAYER_BASE, KC_S));
+  HARNESS_CHECK(harness_report_has_key(&harness_reports[0], KC_S), "leader did not time out");
+  printf("ok - prefix times out without an action\n");
+
+  return 0;
+}
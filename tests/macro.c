@@ -0,0 +1,164 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check that a recorded macro always ends with every key released, including
+// when recording stops because the macro is full. Built with MACRO_PERSIST,
+// also check that the macro is kept in EEPROM without the unsaved settings.
+
+#include "harness.h"
+#include "raw_hid.h"
+
+// Tap a key on the controls layer.
+
+static void tap_controls(uint16_t keycode) {
+  keypos_t layer_key = harness_find(LAYER_BASE, LT_CTLS);
+  harness_event(layer_key, true, 0);
+  harness_tap(harness_find(LAYER_CTLS, keycode));
+  harness_event(layer_key, false, 0);
+}
+
+// Play the macro and return the number of reports it sent, checking that
+// nothing is left held at the end. pressed counts the reports with the key
+// pressed and shifted counts those with shift held.
+
+typedef struct {
+  uint32_t reports;
+  uint32_t pressed;
+  uint32_t shifted;
+} playback_t;
+
+static playback_t play(uint8_t key) {
+
+  playback_t playback = { 0 };
+
+  tap_controls(M_MACRO_PLAY);
+  harness_clear_counts();
+
+  for (uint32_t t = 0; t < 2000; t++) {
+    uint32_t reports = harness_keyboard_reports;
+    harness_advance(1);
+    if (harness_keyboard_reports == reports)
+      continue;
+    playback.reports += harness_keyboard_reports - reports;
+    playback.pressed += harness_report_has_key(&harness_last_report, key);
+    playback.shifted += (harness_last_report.mods & MOD_MASK_SHIFT) != 0;
+  }
+
+  report_keyboard_t empty = { 0 };
+  HARNESS_CHECK(memcmp(&harness_last_report, &empty, sizeof(empty)) == 0,
+    "playback ended with mods %02X and key %02X held", harness_last_report.mods,
+    harness_last_report.keys[0]);
+
+  return playback;
+}
+
+int main(void) {
+
+  keypos_t shift = harness_find(LAYER_BASE, OSM_LSFT);
+  keypos_t n = harness_find(LAYER_BASE, KC_N);
+  keypos_t e = harness_find(LAYER_BASE, KC_E);
+  keypos_t t = harness_find(LAYER_BASE, KC_T);
+  playback_t playback;
+
+  // Keys held when recording stops are released at the end.
+
+  harness_reset(OS_LINUX);
+  tap_controls(M_MACRO_REC);
+  harness_event(shift, true, 0);
+  harness_tap(n);
+  harness_event(n, true, 1);
+  tap_controls(M_MACRO_REC);
+  harness_event(n, false, 1);
+  harness_event(shift, false, 0);
+
+  playback = play(KC_N);
+  HARNESS_CHECK(playback.reports == 6, "short macro sent %u reports", playback.reports);
+  HARNESS_CHECK(playback.pressed == 2, "short macro pressed N %u times", playback.pressed);
+  printf("ok - keys held at the end of recording are released\n");
+
+  // Hold shift and keep typing until the macro is full. Recording stops with
+  // room to release shift and N, whether a press or a release fills it.
+
+  for (uint8_t extra = 0; extra < 2; extra++) {
+
+    harness_reset(OS_LINUX);
+    tap_controls(M_MACRO_REC);
+    harness_event(shift, true, 0);
+    if (extra)
+      harness_tap(e);
+    for (uint8_t i = 0; i < MACRO_SIZE; i++)
+      harness_tap(n);
+    harness_event(n, true, 1);
+    harness_event(shift, false, 0);
+    harness_event(n, false, 1);
+
+    // The press meant to stop recording is ignored, so the full macro is kept
+    // and nothing typed after it is recorded.
+
+    tap_controls(M_MACRO_REC);
+    harness_tap(t);
+
+    playback = play(KC_N);
+    HARNESS_CHECK(playback.reports <= MACRO_SIZE, "full macro sent %u reports", playback.reports);
+    HARNESS_CHECK(playback.reports > MACRO_SIZE - KEYBOARD_REPORT_KEYS - 8 - 2,
+      "full macro stopped early after %u reports", playback.reports);
+    HARNESS_CHECK(playback.shifted == playback.reports - 1, "full macro shifted %u of %u reports",
+      playback.shifted, playback.reports);
+    HARNESS_CHECK(playback.pressed > 0 && ! play(KC_T).pressed, "full macro recorded the wrong keys");
+
+    // Recording then starts as usual.
+
+    tap_controls(M_MACRO_REC);
+    harness_tap(t);
+    tap_controls(M_MACRO_REC);
+    playback = play(KC_T);
+    HARNESS_CHECK(playback.reports == 2 && playback.pressed == 1, "new macro sent %u reports",
+      playback.reports);
+
+  }
+
+  printf("ok - a full macro stops recording and releases every key\n");
+
+#ifdef MACRO_PERSIST
+
+  // Change a setting without saving it, record a macro and restart, keeping
+  // only the EEPROM.
+
+  harness_reset(OS_LINUX);
+  uint8_t request[HID_REPORT_SIZE] = { HID_SET_SETTING, SETTING_TAPPING_TERM_HOMEROW, 180 };
+  raw_hid_receive(request, sizeof(request));
+  tap_controls(M_MACRO_REC);
+  harness_tap(t);
+  tap_controls(M_MACRO_REC);
+
+  uint8_t eeprom[EECONFIG_USER_DATA_SIZE];
+  memcpy(eeprom, harness_eeprom, sizeof(eeprom));
+  harness_reset(OS_LINUX);
+  memcpy(harness_eeprom, eeprom, sizeof(eeprom));
+  keyboard_post_init_user();
+
+  playback = play(KC_T);
+  HARNESS_CHECK(playback.reports == 2 && playback.pressed == 1, "stored macro sent %u reports",
+    playback.reports);
+  HARNESS_CHECK(get_tapping_term(HR_LCTL, NULL) == TAPPING_TERM_HOMEROW,
+    "recording the macro saved a setting that was not saved");
+  printf("ok - the macro is stored without unsaved settings\n");
+
+#endif
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Measure the cost of the userspace mouse movement. The nav layer mouse keys
+// are held through the whole pipeline to check that the pointer speeds up and
+// reports every MOUSE_INTERVAL ms at full speed, then mouse_move and mouse_axis
+// are timed on the host with the pointer and wheel moving diagonally.
+//
+// Host timings only give the relative cost of the code, not the time it takes
+// on the keyboard, so the limits are generous and only catch a report that
+// has become far more expensive than it should be.
+
+#include <time.h>
+
+#include "harness.h"
+
+#define RAMP_TIME 1000
+#define RAMP_WINDOW 32
+#define ITERATIONS 20000000
+#define MOUSE_MOVE_LIMIT_NS 500.0
+#define MOUSE_AXIS_LIMIT_NS 100.0
+
+uint32_t mouse_move(uint32_t trigger_time, void *cb_arg);
+int8_t mouse_axis(uint8_t axis, uint16_t speed, uint8_t negative, uint8_t positive);
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_mouse_move(void) {
+  double start = now_ns();
+  for (uint32_t i = 0; i < ITERATIONS; i++)
+    mouse_move(0, NULL);
+  return (now_ns() - start) / ITERATIONS;
+}
+
+// Hold the nav layer and then the given mouse keys.
+
+static void hold_mouse_keys(const uint16_t *keycodes, uint8_t count) {
+
+  harness_event(harness_find(LAYER_BASE, LT_NAV), true, 0);
+
+  for (uint8_t i = 0; i < count; i++)
+    harness_event(harness_find(LAYER_NAV, keycodes[i]), true, 1);
+
+}
+
+// Hold the pointer right and check that it starts by moving one pixel and
+// that the distance moved in each window of RAMP_WINDOW ms never falls by more
+// than the pixel that a carried over fraction can add or take away. Slow
+// movement skips the intervals where less than a whole pixel has built up,
+// but full speed must report on every interval.
+
+static void check_ramp(void) {
+
+  static const uint16_t keycodes[] = { KC_MS_RIGHT };
+  int32_t distance = 1;
+  int32_t window = 0;
+  int32_t last_window = 0;
+  uint32_t skipped = 0;
+
+  harness_reset(OS_LINUX);
+  hold_mouse_keys(keycodes, ARRAY_SIZE(keycodes));
+
+  HARNESS_CHECK(harness_mouse_reports == 1, "%u reports on press", harness_mouse_reports);
+  HARNESS_CHECK(harness_last_mouse_report.x == 1, "first report moved %d", harness_last_mouse_report.x);
+
+  for (uint32_t t = MOUSE_INTERVAL; t <= RAMP_TIME; t += MOUSE_INTERVAL) {
+
+    uint32_t reports = harness_mouse_reports;
+    harness_advance(MOUSE_INTERVAL);
+
+    HARNESS_CHECK(harness_mouse_reports - reports <= 1, "%u reports in one interval",
+      harness_mouse_reports - reports);
+
+    if (harness_mouse_reports == reports) {
+      skipped = t;
+    } else {
+      HARNESS_CHECK(harness_last_mouse_report.y == 0, "moved %d on y", harness_last_mouse_report.y);
+      window += harness_last_mouse_report.x;
+    }
+
+    if (t % RAMP_WINDOW == 0) {
+      HARNESS_CHECK(window + 1 >= last_window, "slowed from %d to %d pixels per %u ms after %u ms",
+        last_window, window, RAMP_WINDOW, t);
+      distance += window;
+      last_window = window;
+      window = 0;
+    }
+  }
+
+  HARNESS_CHECK(skipped < RAMP_TIME / 2, "skipped a report after %u ms", skipped);
+
+  harness_event(harness_find(LAYER_NAV, KC_MS_RIGHT), false, 1);
+  uint32_t reports = harness_mouse_reports;
+  harness_advance(MOUSE_INTERVAL * 4);
+  HARNESS_CHECK(harness_mouse_reports == reports, "reports sent after release");
+
+  printf("pointer: %u reports in %u ms moved %d pixels, reaching %d pixels per report\n",
+    reports, RAMP_TIME, distance, harness_last_mouse_report.x);
+
+}
+
+int main(void) {
+
+  static const uint16_t keycodes[] = { KC_MS_RIGHT, KC_MS_DOWN, KC_MS_WH_UP, KC_MS_WH_RIGHT };
+
+  check_ramp();
+
+  // Time a report with all four axes moving, part way up the speed curve and
+  // then at full speed, where every call must send a report.
+
+  harness_reset(OS_LINUX);
+  hold_mouse_keys(keycodes, ARRAY_SIZE(keycodes));
+  harness_advance(100);
+  double ramp_ns = time_mouse_move();
+
+  harness_advance(RAMP_TIME);
+  uint32_t reports = harness_mouse_reports;
+  double move_ns = time_mouse_move();
+
+  HARNESS_CHECK(harness_mouse_reports - reports == ITERATIONS, "%u of %u calls sent a report",
+    harness_mouse_reports - reports, ITERATIONS);
+
+  // Time a single axis on its own, with both directions held, one held and
+  // neither held.
+
+  volatile int8_t sink = 0;
+  double start = now_ns();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    sink += mouse_axis(i & 3, i & 0x7FF, 1 << (i & 7), 1 << ((i + 1) & 7));
+  }
+  double axis_ns = (now_ns() - start) / ITERATIONS;
+
+  printf("mouse_move: %.1f ns per call speeding up, %.1f ns per report at full speed (limit %.0f)\n",
+    ramp_ns, move_ns, MOUSE_MOVE_LIMIT_NS);
+  printf("mouse_axis: %.1f ns per axis (limit %.0f)\n", axis_ns, MOUSE_AXIS_LIMIT_NS);
+
+  HARNESS_CHECK(ramp_ns < MOUSE_MOVE_LIMIT_NS, "mouse_move took %.1f ns", ramp_ns);
+  HARNESS_CHECK(move_ns < MOUSE_MOVE_LIMIT_NS, "mouse_move took %.1f ns", move_ns);
+  HARNESS_CHECK(axis_ns < MOUSE_AXIS_LIMIT_NS, "mouse_axis took %.1f ns", axis_ns);
+
+  return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "quantum.h"
+
+void debounce_init(uint8_t num_rows);
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed);
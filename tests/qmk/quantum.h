@@ -0,0 +1,386 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The parts of the QMK API used by the userspace, for building it on the host.
+// Keycodes and report layouts have the same values as in QMK so that the
+// userspace behaves as it does on the keyboard. The implementations are in
+// quantum.c.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "config.h"
+
+// Platform.
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#include <stdio.h>
+
+#ifdef HARNESS_DEBUG
+#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define dprintf(...) do { } while (0)
+#endif
+
+// Matrix. The Ferris Sweep has four rows of five columns on each half, with
+// the left half on rows 0 to 3 and the right half on rows 4 to 7.
+
+#define SPLIT_KEYBOARD
+#define MATRIX_ROWS 8
+#define MATRIX_COLS 5
+
+typedef uint8_t matrix_row_t;
+#define MATRIX_ROW_SHIFTER ((matrix_row_t)1)
+
+#define LAYOUT_split_3x5_2( \
+  L00, L01, L02, L03, L04, R00, R01, R02, R03, R04, \
+  L10, L11, L12, L13, L14, R10, R11, R12, R13, R14, \
+  L20, L21, L22, L23, L24, R20, R21, R22, R23, R24, \
+            L30, L31,           R30, R31 \
+  ) { \
+  { L00, L01, L02, L03, L04 }, \
+  { L10, L11, L12, L13, L14 }, \
+  { L20, L21, L22, L23, L24 }, \
+  { L30, L31, 0, 0, 0 }, \
+  { R00, R01, R02, R03, R04 }, \
+  { R10, R11, R12, R13, R14 }, \
+  { R20, R21, R22, R23, R24 }, \
+  { R30, R31, 0, 0, 0 } \
+}
+
+matrix_row_t matrix_get_row(uint8_t row);
+bool is_keyboard_left(void);
+
+// Timers.
+
+typedef uint32_t fast_timer_t;
+
+uint16_t timer_read(void);
+uint16_t timer_elapsed(uint16_t last);
+#define TIMER_DIFF_16(a, b) ((uint16_t)((a) - (b)))
+uint32_t timer_read32(void);
+uint32_t timer_elapsed32(uint32_t last);
+fast_timer_t timer_read_fast(void);
+fast_timer_t timer_elapsed_fast(fast_timer_t last);
+void wait_ms(uint32_t ms);
+
+// Key events.
+
+typedef struct {
+  uint8_t col;
+  uint8_t row;
+} keypos_t;
+
+typedef struct {
+  keypos_t key;
+  bool pressed;
+  uint16_t time;
+} keyevent_t;
+
+typedef struct {
+  bool interrupted : 1;
+  bool reserved2 : 1;
+  bool reserved1 : 1;
+  bool reserved0 : 1;
+  uint8_t count : 4;
+} tap_t;
+
+typedef struct {
+  keyevent_t event;
+  tap_t tap;
+} keyrecord_t;
+
+// Keycodes.
+
+enum qk_keycodes {
+  KC_NO = 0x00,
+  KC_TRNS = 0x01,
+  KC_A = 0x04, KC_B, KC_C, KC_D, KC_E, KC_F, KC_G, KC_H, KC_I, KC_J, KC_K,
+  KC_L, KC_M, KC_N, KC_O, KC_P, KC_Q, KC_R, KC_S, KC_T, KC_U, KC_V, KC_W,
+  KC_X, KC_Y, KC_Z,
+  KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7, KC_8, KC_9, KC_0,
+  KC_ENT, KC_ESC, KC_BSPC, KC_TAB, KC_SPC, KC_MINS, KC_EQL, KC_LBRC, KC_RBRC,
+  KC_BSLS, KC_NUHS, KC_SCLN, KC_QUOT, KC_GRV, KC_COMMA, KC_DOT, KC_SLSH,
+  KC_CAPS,
+  KC_F1, KC_F2, KC_F3, KC_F4, KC_F5, KC_F6, KC_F7, KC_F8, KC_F9, KC_F10,
+  KC_F11, KC_F12, KC_PSCR, KC_SCRL, KC_PAUS, KC_INS, KC_HOME, KC_PGUP, KC_DEL,
+  KC_END, KC_PGDN, KC_RIGHT, KC_LEFT, KC_DOWN, KC_UP,
+  KC_PSLS = 0x54,
+  KC_NUBS = 0x64,
+  KC_F13 = 0x68, KC_F14, KC_F15,
+  KC_MUTE = 0xA8, KC_VOLU, KC_VOLD, KC_MNXT, KC_MPRV, KC_MSTP, KC_MPLY,
+  KC_BRIU = 0xBD, KC_BRID,
+  KC_MS_UP = 0xCD, KC_MS_DOWN, KC_MS_LEFT, KC_MS_RIGHT, KC_MS_BTN1,
+  KC_MS_BTN2,
+  KC_MS_WH_UP = 0xD9, KC_MS_WH_DOWN, KC_MS_WH_LEFT, KC_MS_WH_RIGHT,
+  KC_LCTL = 0xE0, KC_LSFT, KC_LALT, KC_LGUI, KC_RCTL, KC_RSFT, KC_RALT,
+  KC_RGUI,
+  SAFE_RANGE = 0x7E40
+};
+
+#define KC_RGHT KC_RIGHT
+
+#define IS_MODIFIER_KEYCODE(code) ((code) >= KC_LCTL && (code) <= KC_RGUI)
+#define IS_MOUSE_KEYCODE(code) ((code) >= KC_MS_UP && (code) <= KC_MS_WH_RIGHT)
+#define IS_CONSUMER_KEYCODE(code) ((code) >= KC_MUTE && (code) <= KC_BRID)
+
+// Modified keycodes.
+
+#define QK_LCTL 0x0100
+#define QK_LSFT 0x0200
+#define QK_LALT 0x0400
+#define QK_LGUI 0x0800
+#define QK_RMODS_MIN 0x1000
+
+#define LCTL(kc) (QK_LCTL | (kc))
+#define LSFT(kc) (QK_LSFT | (kc))
+#define LALT(kc) (QK_LALT | (kc))
+#define LGUI(kc) (QK_LGUI | (kc))
+#define RCTL(kc) (QK_RMODS_MIN | QK_LCTL | (kc))
+#define HYPR(kc) (QK_LCTL | QK_LSFT | QK_LALT | QK_LGUI | (kc))
+
+#define KC_EXLM LSFT(KC_1)
+#define KC_DLR LSFT(KC_4)
+#define KC_PERC LSFT(KC_5)
+#define KC_CIRC LSFT(KC_6)
+#define KC_AMPR LSFT(KC_7)
+#define KC_ASTR LSFT(KC_8)
+#define KC_LPRN LSFT(KC_9)
+#define KC_RPRN LSFT(KC_0)
+#define KC_UNDS LSFT(KC_MINS)
+#define KC_PLUS LSFT(KC_EQL)
+#define KC_LCBR LSFT(KC_LBRC)
+#define KC_RCBR LSFT(KC_RBRC)
+#define KC_COLN LSFT(KC_SCLN)
+#define KC_GT LSFT(KC_DOT)
+#define KC_QUES LSFT(KC_SLSH)
+
+#define IS_QK_MODS(code) ((code) >= 0x0100 && (code) <= 0x1FFF)
+
+// Five bit modifiers, as used by the mod-tap and oneshot keycodes, and eight
+// bit modifiers, as used by the mod state and keyboard reports.
+
+#define MOD_LCTL 0x01
+#define MOD_LSFT 0x02
+#define MOD_LALT 0x04
+#define MOD_LGUI 0x08
+#define MOD_RCTL 0x11
+#define MOD_RSFT 0x12
+#define MOD_RALT 0x14
+#define MOD_RGUI 0x18
+
+#define MOD_BIT(code) (1 << ((code) & 0x07))
+#define MOD_MASK_CTRL (MOD_BIT(KC_LCTL) | MOD_BIT(KC_RCTL))
+#define MOD_MASK_SHIFT (MOD_BIT(KC_LSFT) | MOD_BIT(KC_RSFT))
+#define MOD_MASK_ALT (MOD_BIT(KC_LALT) | MOD_BIT(KC_RALT))
+#define MOD_MASK_GUI (MOD_BIT(KC_LGUI) | MOD_BIT(KC_RGUI))
+
+// Tap-hold and oneshot keycodes.
+
+#define QK_MOD_TAP 0x2000
+#define QK_LAYER_TAP 0x4000
+#define QK_ONE_SHOT_MOD 0x52A0
+
+#define MT(mod, kc) (QK_MOD_TAP | (((mod) & 0x1F) << 8) | ((kc) & 0xFF))
+#define LCTL_T(kc) MT(MOD_LCTL, kc)
+#define LALT_T(kc) MT(MOD_LALT, kc)
+#define LGUI_T(kc) MT(MOD_LGUI, kc)
+#define LCA_T(kc) MT(MOD_LCTL | MOD_LALT, kc)
+#define LT(layer, kc) (QK_LAYER_TAP | (((layer) & 0x0F) << 8) | ((kc) & 0xFF))
+#define OSM(mod) (QK_ONE_SHOT_MOD | ((mod) & 0x1F))
+
+#define IS_QK_MOD_TAP(code) ((code) >= 0x2000 && (code) <= 0x3FFF)
+#define IS_QK_LAYER_TAP(code) ((code) >= 0x4000 && (code) <= 0x4FFF)
+#define IS_QK_ONE_SHOT_MOD(code) ((code) >= 0x52A0 && (code) <= 0x52BF)
+
+#define QK_MOD_TAP_GET_MODS(code) (((code) >> 8) & 0x1F)
+#define QK_LAYER_TAP_GET_LAYER(code) (((code) >> 8) & 0x0F)
+#define QK_ONE_SHOT_MOD_GET_MODS(code) ((code) & 0x1F)
+
+// Modifiers.
+
+uint8_t get_mods(void);
+void add_mods(uint8_t mods);
+void del_mods(uint8_t mods);
+void set_mods(uint8_t mods);
+void clear_mods(void);
+void register_mods(uint8_t mods);
+void unregister_mods(uint8_t mods);
+
+uint8_t get_weak_mods(void);
+void add_weak_mods(uint8_t mods);
+void del_weak_mods(uint8_t mods);
+void set_weak_mods(uint8_t mods);
+void clear_weak_mods(void);
+
+uint8_t get_oneshot_mods(void);
+void add_oneshot_mods(uint8_t mods);
+void del_oneshot_mods(uint8_t mods);
+void clear_oneshot_mods(void);
+
+// Layers.
+
+typedef uint32_t layer_state_t;
+
+extern layer_state_t layer_state;
+
+uint8_t get_highest_layer(layer_state_t state);
+void layer_on(uint8_t layer);
+void layer_off(uint8_t layer);
+uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key);
+
+// Keyboard reports.
+
+#define KEYBOARD_REPORT_KEYS 6
+
+typedef struct {
+  uint8_t mods;
+  uint8_t reserved;
+  uint8_t keys[KEYBOARD_REPORT_KEYS];
+} report_keyboard_t;
+
+typedef struct {
+  uint8_t buttons;
+  int8_t x;
+  int8_t y;
+  int8_t v;
+  int8_t h;
+} report_mouse_t;
+
+typedef struct {
+  uint8_t (*keyboard_leds)(void);
+  void (*send_keyboard)(report_keyboard_t *report);
+  void (*send_nkro)(report_keyboard_t *report);
+  void (*send_mouse)(report_mouse_t *report);
+  void (*send_extra)(void *report);
+} host_driver_t;
+
+extern report_keyboard_t *keyboard_report;
+
+host_driver_t *host_get_driver(void);
+void host_set_driver(host_driver_t *driver);
+void host_mouse_send(report_mouse_t *report);
+void send_keyboard_report(void);
+report_mouse_t mousekey_get_report(void);
+
+void register_code(uint8_t code);
+void unregister_code(uint8_t code);
+void tap_code(uint8_t code);
+void register_code16(uint16_t code);
+void unregister_code16(uint16_t code);
+void tap_code16(uint16_t code);
+
+// Send string. The SS_ macros encode keys as two hex digits, as in QMK.
+
+#define SS_QMK_PREFIX 1
+#define SS_TAP_CODE 1
+#define SS_DOWN_CODE 2
+#define SS_UP_CODE 3
+#define SS_DELAY_CODE 4
+
+#define SS_STRINGIZE(x) #x
+#define SS_STRINGIZE_EXPANDED(x) SS_STRINGIZE(x)
+#define SS_HEX(code) SS_STRINGIZE(\x##code)
+#define SS_HEX_EXPANDED(code) SS_HEX(code)
+
+#define SS_TAP(keycode) "\1\1" SS_HEX_EXPANDED(keycode)
+#define SS_DOWN(keycode) "\1\2" SS_HEX_EXPANDED(keycode)
+#define SS_UP(keycode) "\1\3" SS_HEX_EXPANDED(keycode)
+#define SS_DELAY(msecs) "\1\4" SS_STRINGIZE_EXPANDED(msecs) "|"
+
+#define X_1 1e
+#define X_2 1f
+#define X_3 20
+#define X_4 21
+#define X_5 22
+#define X_ESC 29
+#define X_TAB 2b
+#define X_SPC 2c
+#define X_MINS 2d
+#define X_EQL 2e
+#define X_LBRC 2f
+#define X_RBRC 30
+#define X_SCLN 33
+#define X_F5 3e
+#define X_F11 44
+#define X_RGHT 4f
+#define X_LEFT 50
+#define X_DOWN 51
+#define X_UP 52
+#define X_LCTL e0
+#define X_LSFT e1
+#define X_LALT e2
+#define X_LGUI e3
+
+#define SEND_STRING(string) send_string(string)
+
+void send_string(const char *string);
+
+// Caps word.
+
+bool is_caps_word_on(void);
+void caps_word_on(void);
+void caps_word_off(void);
+void caps_word_toggle(void);
+
+// Deferred execution.
+
+typedef uint8_t deferred_token;
+typedef uint32_t (*deferred_exec_callback)(uint32_t trigger_time, void *cb_arg);
+
+#define INVALID_DEFERRED_TOKEN 0
+
+deferred_token defer_exec(uint32_t delay_ms, deferred_exec_callback callback, void *cb_arg);
+bool extend_deferred_exec(deferred_token token, uint32_t delay_ms);
+bool cancel_deferred_exec(deferred_token token);
+
+// EEPROM.
+
+void eeconfig_read_user_datablock(void *data);
+void eeconfig_update_user_datablock(const void *data);
+
+// Processing.
+
+void action_tapping_process(keyrecord_t record);
+
+// Userspace hooks.
+
+bool pre_process_record_user(uint16_t keycode, keyrecord_t *record);
+bool process_record_user(uint16_t keycode, keyrecord_t *record);
+bool caps_word_press_user(uint16_t keycode);
+void caps_word_set_user(bool active);
+void housekeeping_task_user(void);
+void keyboard_post_init_user(void);
+void eeconfig_init_user(void);
+uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record);
+bool get_permissive_hold(uint16_t keycode, keyrecord_t *record);
+bool get_retro_tapping(uint16_t keycode, keyrecord_t *record);
@@ -0,0 +1,145 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Check the number of keyboard and raw HID reports sent and the time spent in
+// delays when each custom keycode is tapped on Windows, ChromeOS and Linux,
+// and on the paths that send extra reports for ordinary keys: shift-backspace
+// sending delete and the opposite hand rule tapping a key without the held
+// modifiers. Every case must have a budget and fails if it sends more reports
+// or waits longer than its budget. Lower a budget when a change makes a case
+// cheaper.
+
+#include "harness.h"
+
+// A key is tapped on its layer, with another key held first if it is not
+// KC_NO. The reports are counted from the press of the tapped key to its
+// release, on Windows, ChromeOS and Linux, separately for keyboard and raw HID
+// reports, and the delay in milliseconds is the time spent in SS_DELAY and
+// wait_ms.
+
+typedef struct {
+  uint16_t held;
+  uint16_t keycode;
+  uint8_t reports[3];
+  uint8_t raw_reports[3];
+  uint16_t delay;
+} budget_t;
+
+static const budget_t budgets[] = {
+  { KC_NO,    M_ALT_TAB,    { 3, 3, 3 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_ESC_COLN,   { 6, 6, 6 }, { 0, 0, 0 }, 100 },
+  { KC_NO,    M_NDESK,      { 6, 4, 6 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_PDESK,      { 6, 4, 6 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_OVERVIEW,   { 4, 2, 6 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_FULLSCREEN, { 2, 4, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_MINIMISE,   { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_EMOJI,      { 4, 6, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_LEADER,     { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_MACRO_REC,  { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_MACRO_PLAY, { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_APP_1,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_APP_2,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_APP_3,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_APP_4,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_APP_5,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_MAXIMISE,   { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_CLOSE,      { 4, 4, 0 }, { 0, 0, 1 }, 0 },
+  { KC_NO,    M_ISWINDOWS,  { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_ISCHROMEOS, { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { KC_NO,    M_ISLINUX,    { 0, 0, 0 }, { 0, 0, 0 }, 0 },
+  { OSM_LSFT, KC_BSPC,      { 2, 2, 2 }, { 0, 0, 0 }, 0 },
+  { HR_LCTL,  KC_T,         { 3, 3, 3 }, { 0, 0, 0 }, 0 },
+  { HR_RCTL,  KC_N,         { 3, 3, 3 }, { 0, 0, 0 }, 0 }
+};
+
+static const char *os_names[] = { "windows", "chromeos", "linux" };
+
+// Find the lowest layer that has the keycode, and where.
+
+static uint8_t find_layer(uint16_t keycode, keypos_t *key) {
+  for (uint8_t layer = LAYER_BASE; layer <= LAYER_CTLS; layer++) {
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+      for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        *key = (keypos_t){ .col = col, .row = row };
+        if (keymap_key_to_keycode(layer, *key) == keycode)
+          return layer;
+      }
+    }
+  }
+  fprintf(stderr, "keycode %04X is not in the keymap\n", keycode);
+  exit(1);
+}
+
+static const budget_t *find_budget(uint16_t held, uint16_t keycode) {
+  for (uint8_t i = 0; i < ARRAY_SIZE(budgets); i++) {
+    if (budgets[i].held == held && budgets[i].keycode == keycode)
+      return &budgets[i];
+  }
+  return NULL;
+}
+
+// Tap the key with the layer it is on turned on, holding the other key first,
+// and check the reports and delay against the budget.
+
+static void check_budget(const budget_t *budget, uint8_t os) {
+
+  keypos_t key;
+  uint8_t layer = find_layer(budget->keycode, &key);
+
+  harness_reset(os);
+
+  if (budget->held != KC_NO)
+    harness_event(harness_find(LAYER_BASE, budget->held), true, 0);
+
+  if (layer != LAYER_BASE)
+    layer_on(layer);
+
+  harness_clear_counts();
+  harness_tap(key);
+
+  // Shift-backspace must have sent delete rather than a shifted backspace.
+
+  if (budget->keycode == KC_BSPC) {
+    bool deleted = false;
+    for (uint32_t i = 0; i < harness_keyboard_reports && i < HARNESS_REPORT_LOG_SIZE; i++)
+      deleted |= harness_report_has_key(&harness_reports[i], KC_DEL);
+    HARNESS_CHECK(deleted, "shift-backspace did not send delete on %s", os_names[os]);
+  }
+
+  HARNESS_CHECK(harness_keyboard_reports <= budget->reports[os] && harness_delay <= budget->delay,
+    "%04X held, %04X tapped on %s: %u reports in %u ms, budget %u reports in %u ms", budget->held,
+    budget->keycode, os_names[os], harness_keyboard_reports, harness_delay, budget->reports[os],
+    budget->delay);
+  HARNESS_CHECK(harness_raw_hid_reports <= budget->raw_reports[os],
+    "%04X held, %04X tapped on %s: %u raw HID reports, budget %u", budget->held, budget->keycode,
+    os_names[os], harness_raw_hid_reports, budget->raw_reports[os]);
+}
+
+int main(void) {
+
+  for (uint16_t keycode = M_ALT_TAB; keycode <= M_ISLINUX; keycode++)
+    HARNESS_CHECK(find_budget(KC_NO, keycode), "no budget for keycode %04X", keycode);
+
+  for (uint8_t i = 0; i < ARRAY_SIZE(budgets); i++) {
+    for (uint8_t os = OS_WINDOWS; os <= OS_LINUX; os++)
+      check_budget(&budgets[i], os);
+  }
+
+  printf("ok - %u cases within their report and delay budgets on every os\n", (unsigned)ARRAY_SIZE(budgets));
+
+  return 0;
+}
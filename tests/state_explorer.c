@@ -0,0 +1,425 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Explore key event sequences and check that nothing is left held once every
+// key has been released. Every sequence of presses, releases and waits up to
+// the given depth is tried over the keys that hold modifiers, layers or other
+// state, for each operating system, followed by random sequences over the
+// whole keyboard. After each sequence any keys still down are released and the
+// clock is moved on, and then no modifier may be registered, no key or
+// modifier may be left in the last report apart from oneshot mods and caps word
+// shift, no layer may be on and no userspace state may still track a held key.
+//
+// The work is split across forked processes, one per core by default.
+//
+//   state_explorer [-d depth] [-f fuzzed sequences] [-j jobs] [-s seed]
+
+#include <getopt.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#define DEFAULT_DEPTH 4
+#define DEFAULT_FUZZ 1000000
+#define MAX_DEPTH 8
+#define FUZZ_LENGTH 24
+#define EXPLORE_WAIT 300
+#define SETTLE_TIME 5000
+#define SPLIT_DEPTH 2
+#define KEY_COUNT (MATRIX_ROWS * MATRIX_COLS)
+
+static const char *os_names[] = { "windows", "chromeos", "linux" };
+
+// The keys explored exhaustively, by their keycode on the base layer. The
+// other layers put the alt-tab, escape-colon, minimise, delete and modifier
+// keys under the same positions.
+
+static const uint16_t explore_keycodes[] = {
+  OSM_LSFT, OSM_RSFT, LT_NAV, LT_NUM, LT_LSYM, LT_RSYM, LT_CTLS,
+  HR_LCTL, HR_RCTL, HR_RCA, KC_W, KC_R, KC_N, KC_Y, KC_BSPC
+};
+
+#define EXPLORE_COUNT ARRAY_SIZE(explore_keycodes)
+
+// A step is a press or release of a key with the tap count decided by the
+// tapping code, or a wait.
+
+typedef struct {
+  uint8_t key;
+  bool pressed;
+  uint8_t tap_count;
+  uint16_t wait;
+} step_t;
+
+static keypos_t positions[KEY_COUNT];
+static uint8_t explore_keys[EXPLORE_COUNT];
+
+static void print_steps(uint8_t os, const step_t *steps, uint8_t length) {
+
+  fprintf(stderr, "  os %s\n", os_names[os]);
+
+  for (uint8_t i = 0; i < length; i++) {
+    const step_t *step = &steps[i];
+    if (step->wait) {
+      fprintf(stderr, "  wait %u ms\n", step->wait);
+      continue;
+    }
+    keypos_t key = positions[step->key];
+    fprintf(stderr, "  %s row %u col %u (base %04X) tap count %u\n", step->pressed ? "press" : "release",
+      key.row, key.col, keymap_key_to_keycode(LAYER_BASE, key), step->tap_count);
+  }
+}
+
+// Check that nothing is held, returning a description of what is if it is.
+
+static const char *check_released(void) {
+
+  static char problem[80];
+
+  uint8_t caps_word_shift = is_caps_word_on() ? MOD_MASK_SHIFT : 0;
+  uint8_t allowed = get_oneshot_mods() | caps_word_shift;
+
+  if (get_mods()) {
+    snprintf(problem, sizeof(problem), "mods %02X registered", get_mods());
+    return problem;
+  }
+
+  if (get_weak_mods() & ~caps_word_shift) {
+    snprintf(problem, sizeof(problem), "weak mods %02X registered", get_weak_mods());
+    return problem;
+  }
+
+  if (harness_last_report.mods & ~allowed) {
+    snprintf(problem, sizeof(problem), "mods %02X left in the last report", harness_last_report.mods);
+    return problem;
+  }
+
+  for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+    if (harness_last_report.keys[i]) {
+      snprintf(problem, sizeof(problem), "key %02X left in the last report", harness_last_report.keys[i]);
+      return problem;
+    }
+  }
+
+  if (layer_state) {
+    snprintf(problem, sizeof(problem), "layer state %08X", (unsigned)layer_state);
+    return problem;
+  }
+
+  const char *held = harness_user_held();
+  if (held) {
+    snprintf(problem, sizeof(problem), "%s still set", held);
+    return problem;
+  }
+
+  return NULL;
+}
+
+// Run a sequence from a freshly reset keyboard, release whatever is still down
+// in the order it was pressed, let any timers run out, and check the state.
+// Exits with the sequence if the check fails.
+
+static void run(uint8_t os, const step_t *steps, uint8_t length) {
+
+  uint8_t down[FUZZ_LENGTH];
+  uint8_t down_taps[FUZZ_LENGTH];
+  uint8_t down_count = 0;
+
+  harness_reset(os);
+
+  for (uint8_t i = 0; i < length; i++) {
+
+    const step_t *step = &steps[i];
+
+    if (step->wait) {
+      harness_advance(step->wait);
+      continue;
+    }
+
+    harness_event(positions[step->key], step->pressed, step->tap_count);
+
+    if (step->pressed) {
+      down[down_count] = step->key;
+      down_taps[down_count++] = step->tap_count;
+      continue;
+    }
+
+    for (uint8_t j = 0; j < down_count; j++) {
+      if (down[j] == step->key) {
+        down_count--;
+        memmove(&down[j], &down[j + 1], down_count - j);
+        memmove(&down_taps[j], &down_taps[j + 1], down_count - j);
+        break;
+      }
+    }
+  }
+
+  for (uint8_t j = 0; j < down_count; j++)
+    harness_event(positions[down[j]], false, down_taps[j]);
+
+  harness_advance(SETTLE_TIME);
+
+  const char *problem = check_released();
+
+  if (problem) {
+    fprintf(stderr, "%s after releasing every key:\n", problem);
+    print_steps(os, steps, length);
+    exit(1);
+  }
+}
+
+// Exhaustive search. Each subtree below SPLIT_DEPTH steps is given to one
+// worker, and the shorter sequences above it are run by the first worker.
+
+typedef struct {
+  uint8_t depth;
+  uint8_t worker;
+  uint8_t jobs;
+  uint32_t subtree;
+  uint64_t sequences;
+  step_t steps[MAX_DEPTH];
+  bool down[KEY_COUNT];
+  uint8_t taps[KEY_COUNT];
+} search_t;
+
+static void explore(search_t *search, uint8_t length);
+
+static void explore_step(search_t *search, uint8_t length, step_t step) {
+
+  if (length + 1 == SPLIT_DEPTH && search->subtree++ % search->jobs != search->worker)
+    return;
+
+  search->steps[length] = step;
+
+  if (length + 1 >= SPLIT_DEPTH || search->worker == 0) {
+    for (uint8_t os = OS_WINDOWS; os <= OS_LINUX; os++)
+      run(os, search->steps, length + 1);
+    search->sequences += 3;
+  }
+
+  if (step.wait) {
+    explore(search, length + 1);
+    return;
+  }
+
+  search->down[step.key] = step.pressed;
+  search->taps[step.key] = step.tap_count;
+  explore(search, length + 1);
+  search->down[step.key] = ! step.pressed;
+}
+
+static void explore(search_t *search, uint8_t length) {
+
+  if (length == search->depth)
+    return;
+
+  for (uint8_t i = 0; i < EXPLORE_COUNT; i++) {
+
+    uint8_t key = explore_keys[i];
+
+    if (search->down[key]) {
+      uint8_t tap_count = search->taps[key];
+      explore_step(search, length, (step_t){ .key = key, .pressed = false, .tap_count = tap_count });
+      search->taps[key] = tap_count;
+      continue;
+    }
+
+    for (uint8_t tap_count = 0; tap_count <= 1; tap_count++)
+      explore_step(search, length, (step_t){ .key = key, .pressed = true, .tap_count = tap_count });
+  }
+
+  if (! length || ! search->steps[length - 1].wait)
+    explore_step(search, length, (step_t){ .wait = EXPLORE_WAIT });
+}
+
+// Random sequences over every key, with tap counts up to five for the shift
+// keys and waits either side of the combo, tapping and repeat timings.
+
+static uint64_t random_state;
+
+static uint32_t random_below(uint32_t limit) {
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return (random_state >> 32) % limit;
+}
+
+static uint64_t fuzz(uint64_t count) {
+
+  static const uint16_t waits[] = { 1, 10, 50, 250, 1000 };
+  static const uint8_t taps[] = { 0, 0, 1, 1, 1, 2, 3, 4, 5 };
+
+  step_t steps[FUZZ_LENGTH];
+  bool down[KEY_COUNT];
+  uint8_t down_taps[KEY_COUNT];
+
+  for (uint64_t n = 0; n < count; n++) {
+
+    uint8_t length = 1 + random_below(FUZZ_LENGTH);
+    memset(down, 0, sizeof(down));
+
+    for (uint8_t i = 0; i < length; i++) {
+
+      if (random_below(6) == 0) {
+        steps[i] = (step_t){ .wait = waits[random_below(ARRAY_SIZE(waits))] };
+        continue;
+      }
+
+      uint8_t key = random_below(EXPLORE_COUNT * 2) < EXPLORE_COUNT ?
+        explore_keys[random_below(EXPLORE_COUNT)] : random_below(KEY_COUNT);
+
+      if (down[key]) {
+        steps[i] = (step_t){ .key = key, .pressed = false, .tap_count = down_taps[key] };
+        down[key] = false;
+      } else {
+        down_taps[key] = taps[random_below(ARRAY_SIZE(taps))];
+        steps[i] = (step_t){ .key = key, .pressed = true, .tap_count = down_taps[key] };
+        down[key] = true;
+      }
+    }
+
+    run(random_below(3), steps, length);
+  }
+
+  return count;
+}
+
+static uint64_t work(uint8_t worker, uint8_t jobs, uint8_t depth, uint64_t fuzz_count, uint64_t seed) {
+
+  static search_t search;
+
+  search = (search_t){ .depth = depth, .worker = worker, .jobs = jobs };
+  explore(&search, 0);
+
+  random_state = seed * 0x9E3779B97F4A7C15ull + worker + 1;
+  uint64_t share = fuzz_count / jobs + (worker < fuzz_count % jobs);
+
+  return search.sequences + fuzz(share);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+
+  long depth = DEFAULT_DEPTH;
+  long long fuzz_count = DEFAULT_FUZZ;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned long long seed = 1;
+  int option;
+
+  while ((option = getopt(argc, argv, "d:f:j:s:")) != -1) {
+    switch (option) {
+      case 'd':
+        depth = atol(optarg);
+        break;
+      case 'f':
+        fuzz_count = atoll(optarg);
+        break;
+      case 'j':
+        jobs = atol(optarg);
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-d depth] [-f fuzzed sequences] [-j jobs] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if (depth < 0 || depth > MAX_DEPTH || fuzz_count < 0 || jobs < 1 || jobs > 255) {
+    fprintf(stderr, "depth must be 0 to %u, jobs 1 to 255\n", MAX_DEPTH);
+    return 2;
+  }
+
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    for (uint8_t col = 0; col < MATRIX_COLS; col++)
+      positions[row * MATRIX_COLS + col] = (keypos_t){ .col = col, .row = row };
+  }
+
+  for (uint8_t i = 0; i < EXPLORE_COUNT; i++) {
+    keypos_t key = harness_find(LAYER_BASE, explore_keycodes[i]);
+    explore_keys[i] = key.row * MATRIX_COLS + key.col;
+  }
+
+  // Each worker writes the number of sequences it ran to the pipe. The first
+  // worker to fail stops the rest.
+
+  int results[2];
+  pid_t workers[255];
+  double start = now();
+
+  if (pipe(results)) {
+    perror("pipe");
+    return 1;
+  }
+
+  fflush(stdout);
+
+  for (long worker = 0; worker < jobs; worker++) {
+    workers[worker] = fork();
+    if (workers[worker] < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (! workers[worker]) {
+      uint64_t sequences = work(worker, jobs, depth, fuzz_count, seed);
+      if (write(results[1], &sequences, sizeof(sequences)) != sizeof(sequences))
+        _exit(1);
+      _exit(0);
+    }
+  }
+
+  close(results[1]);
+
+  int failed = 0;
+
+  for (long remaining = jobs; remaining; remaining--) {
+    int status;
+    if (wait(&status) < 0)
+      break;
+    if (! failed && ! (WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+      failed = 1;
+      for (long worker = 0; worker < jobs; worker++)
+        kill(workers[worker], SIGTERM);
+    }
+  }
+
+  if (failed)
+    return 1;
+
+  uint64_t total = 0;
+  uint64_t sequences;
+
+  while (read(results[0], &sequences, sizeof(sequences)) == sizeof(sequences))
+    total += sequences;
+
+  double elapsed = now() - start;
+
+  printf("explored %llu sequences to depth %ld and fuzzed with seed %llu on %ld cores in %.1f s, "
+    "%.2f million per second\n", (unsigned long long)total, depth, seed, jobs, elapsed,
+    total / elapsed / 1e6);
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+
+# Test hbm_actions.py by sending it the raw HID reports printed by
+# action_reports.c over its socket, with --dry-run, and checking the commands
+# it prints.
+#
+# Usage:
+#
+#   test_hbm_actions.py ACTION_REPORTS
+
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+ACTIONS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "hbm_actions.py")
+
+# The commands for the app, minimise, maximise and close keys, in the order
+# action_reports.c taps them.
+
+EXPECTED = [
+    "wmctrl -x -a google-chrome",
+    "wmctrl -x -a gnome-terminal-server",
+    "wmctrl -x -a teams-for-linux",
+    "wmctrl -x -a org.gnome.Nautilus",
+    "wmctrl -x -a remmina",
+    "xdotool getactivewindow windowminimize",
+    "wmctrl -r :ACTIVE: -b toggle,maximized_vert,maximized_horz",
+    "wmctrl -c :ACTIVE:",
+]
+
+
+def expect(description, actual, expected):
+    if actual != expected:
+        sys.exit("{}: expected {!r}, got {!r}".format(description, expected, actual))
+    print("ok - {}".format(description))
+
+
+def main():
+    reports = subprocess.run([sys.argv[1]], capture_output=True, text=True, check=True,
+                             timeout=10).stdout.split()
+    expect("keyboard sent a report for each key", len(reports), len(EXPECTED))
+
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "actions.sock")
+        daemon = subprocess.Popen([sys.executable, ACTIONS, "--socket", path, "--dry-run"],
+                                  stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        try:
+            for _ in range(100):
+                if os.path.exists(path) or daemon.poll() is not None:
+                    break
+                time.sleep(0.05)
+            if not os.path.exists(path):
+                sys.exit("hbm_actions.py did not open its socket: {}".format(daemon.stderr.read()))
+
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+
+            # A report that is not an action must be ignored.
+
+            sock.sendto(bytes(32), path)
+            for report in reports:
+                sock.sendto(bytes.fromhex(report), path)
+            sock.close()
+
+            # Stop the daemon if it prints fewer commands than expected, so that
+            # reading them does not hang.
+
+            timer = threading.Timer(10, daemon.kill)
+            timer.start()
+            commands = [daemon.stdout.readline().strip() for _ in EXPECTED]
+            timer.cancel()
+            expect("every action runs its command", commands, EXPECTED)
+        finally:
+            daemon.kill()
+            daemon.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+
+# Test hbm_tune.py against the fake hidraw device in hid_device.c, which
+# answers with the userspace raw_hid_receive.
+#
+# Usage:
+#
+#   test_hbm_tune.py HID_DEVICE
+
+import os
+import pty
+import signal
+import subprocess
+import sys
+
+TUNE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "hbm_tune.py")
+
+
+def tune(device, *args, check=True):
+    result = subprocess.run([sys.executable, TUNE, "--device", device, "--timeout", "2"] + list(args),
+                            capture_output=True, text=True, timeout=10)
+    if check and result.returncode != 0:
+        sys.exit("hbm_tune.py {} failed: {}".format(" ".join(args), result.stderr.strip()))
+    return result
+
+
+def settings(device):
+    values = {}
+    for line in tune(device, "get").stdout.splitlines():
+        name, value = line.split(" = ")
+        values[name] = value
+    return values
+
+
+def expect(description, actual, expected):
+    if actual != expected:
+        sys.exit("{}: expected {!r}, got {!r}".format(description, expected, actual))
+    print("ok - {}".format(description))
+
+
+def restart(keyboard):
+    keyboard.send_signal(signal.SIGUSR1)
+    expect("keyboard restarted", keyboard.stdout.readline().strip(), "restarted")
+
+
+def main():
+    keyboard = subprocess.Popen([sys.argv[1]], stdout=subprocess.PIPE, text=True)
+    try:
+        device = keyboard.stdout.readline().strip()
+        defaults = settings(device)
+
+        expect("get one setting", tune(device, "get", "tapping_term_homerow").stdout.strip(),
+               "tapping_term_homerow = " + defaults["tapping_term_homerow"])
+
+        tune(device, "set", "tapping_term_homerow", "180")
+        tune(device, "set", "retro_tapping_keys", "lt_nav,hr_rgui")
+        changed = dict(defaults, tapping_term_homerow="180", retro_tapping_keys="lt_nav,hr_rgui")
+        expect("set takes effect", settings(device), changed)
+
+        restart(keyboard)
+        expect("unsaved settings are lost on restart", settings(device), defaults)
+
+        tune(device, "set", "tapping_term_homerow", "180")
+        tune(device, "set", "retro_tapping_keys", "lt_nav,hr_rgui")
+        tune(device, "save")
+        restart(keyboard)
+        expect("saved settings are kept on restart", settings(device), changed)
+
+        tune(device, "reset")
+        expect("reset restores the defaults", settings(device), defaults)
+        restart(keyboard)
+        expect("reset is kept on restart", settings(device), defaults)
+
+        result = tune(device, "set", "tapping_term_homerow", "x", check=False)
+        expect("bad value is rejected", result.stderr.strip(), "Error: x is not a number")
+
+        result = tune(device, "set", "tapping_term_homerow", "65536", check=False)
+        expect("value too big to send is rejected", result.stderr.strip(),
+               "Error: 65536 is out of range - expected 0 to 65535")
+
+        result = tune(device, "set", "tapping_term_homerow", "-1", check=False)
+        expect("negative value is rejected", result.stderr.strip(),
+               "Error: -1 is out of range - expected 0 to 65535")
+
+        result = tune(device, "set", "tapping_term_homerow", "5", check=False)
+        expect("keyboard rejects a value outside the setting's range", result.stderr.strip(),
+               "Error: keyboard rejected 5 for tapping_term_homerow - value out of range")
+        expect("rejected value is not set", settings(device), defaults)
+    finally:
+        keyboard.kill()
+        keyboard.wait()
+
+    # A device that never answers must time out rather than hang.
+
+    controller, device = pty.openpty()
+    try:
+        result = tune(os.ttyname(device), "get", check=False)
+        expect("unanswered request times out", "no response" in result.stderr, True)
+    finally:
+        os.close(controller)
+        os.close(device)
+
+
+if __name__ == "__main__":
+    main()
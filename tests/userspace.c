@@ -0,0 +1,124 @@
+/*
+Copyright 2023 Hannah Blythe Morrison
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The userspace built for the host. It is included rather than linked so that
+// its static state can be reset between test cases without restarting the
+// process. Any static added to hbmorrison.c must also be reset here.
+
+#include "../hbmorrison.c"
+
+#include "harness.h"
+
+void harness_reset_user(void) {
+
+  selected_operating_system = OS_WINDOWS;
+
+  rsft_held = false;
+  rctl_held = false;
+  ralt_held = false;
+  rgui_held = false;
+  rca_held = false;
+  sym_layer_shift_mods = 0;
+  del_registered = false;
+
+  alt_tab_state = false;
+  alt_tab_reverse = false;
+  alt_tab_interval = ALT_TAB_REPEAT_INTERVAL;
+  alt_tab_repeat_token = INVALID_DEFERRED_TOKEN;
+  alt_tab_idle_token = INVALID_DEFERRED_TOKEN;
+
+  memset(&hbm_config, 0, sizeof(hbm_config));
+  memset(recorded_macro, 0, sizeof(*recorded_macro));
+  macro_recording = false;
+  macro_playing = false;
+  macro_overflowed = false;
+  memset(&macro_last_report, 0, sizeof(macro_last_report));
+  macro_position = 0;
+  hbm_original_driver = NULL;
+  memset(&hbm_driver, 0, sizeof(hbm_driver));
+
+  caps_word_timer = 0;
+  caps_word_mode = CW_SHOUTING_CASE;
+  caps_word_shift_next = false;
+
+  leader_node = LN_INACTIVE;
+  leader_token = INVALID_DEFERRED_TOKEN;
+  memset(leader_consumed, 0, sizeof(leader_consumed));
+  leader_sending = false;
+
+  nav_repeat_keycode = KC_NO;
+  nav_repeat_down = false;
+  nav_repeat_interval = NAV_REPEAT_INTERVAL;
+  nav_repeat_token = INVALID_DEFERRED_TOKEN;
+
+  mouse_directions = 0;
+  memset(mouse_fractions, 0, sizeof(mouse_fractions));
+  mouse_timer = 0;
+  wheel_timer = 0;
+  mouse_token = INVALID_DEFERRED_TOKEN;
+
+  memset(combo_masks, 0, sizeof(combo_masks));
+  combo_keys = 0;
+  combo_pressed = 0;
+  combo_consumed = 0;
+  memset(combo_buffer, 0, sizeof(combo_buffer));
+  combo_buffer_length = 0;
+  combo_token = INVALID_DEFERRED_TOKEN;
+  combo_flushing = false;
+
+  memset(debounce_counters, 0, sizeof(debounce_counters));
+  debounce_timer = 0;
+  debounce_counting = false;
+  debounce_row_offset = 0;
+
+}
+
+const char *harness_user_held(void) {
+
+  if (rsft_held)
+    return "rsft_held";
+  if (rctl_held)
+    return "rctl_held";
+  if (ralt_held)
+    return "ralt_held";
+  if (rgui_held)
+    return "rgui_held";
+  if (rca_held)
+    return "rca_held";
+  if (sym_layer_shift_mods)
+    return "sym_layer_shift_mods";
+  if (del_registered)
+    return "del_registered";
+  if (alt_tab_state)
+    return "alt_tab_state";
+  if (nav_repeat_keycode != KC_NO)
+    return "nav_repeat_keycode";
+  if (mouse_directions)
+    return "mouse_directions";
+  if (macro_playing)
+    return "macro_playing";
+  for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    if (leader_consumed[row])
+      return "leader_consumed";
+  }
+  if (combo_buffer_length)
+    return "combo_buffer_length";
+  if (combo_consumed)
+    return "combo_consumed";
+
+  return NULL;
+}